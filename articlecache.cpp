@@ -0,0 +1,135 @@
+#include <memory>
+#include <limits>
+#include <QMutexLocker>
+#include "articlecache.h"
+#include "qsl.h"
+
+namespace CDefaults {
+const int articleCompressionThreshold = 512;
+const int articleCompressionLevel = 6;
+}
+
+ZArticleCache::ZArticleCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ZArticleCache::~ZArticleCache() = default;
+
+void ZArticleCache::setMaxBytes(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    const int before = m_cache.count();
+    m_cache.setMaxCost(static_cast<int>(qBound<qint64>(0,bytes,std::numeric_limits<int>::max())));
+    m_evictions += static_cast<quint64>(before - m_cache.count());
+}
+
+void ZArticleCache::setCompression(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_compression = enabled;
+}
+
+bool ZArticleCache::lookup(const QString &word, quint32 generation, QString &article)
+{
+    QByteArray data;
+    bool compressed = false;
+    {
+        QMutexLocker locker(&m_mutex);
+
+        // QCache::object() also moves the entry to the head of the LRU list
+        const Entry* entry = m_cache.object(qMakePair(generation,word));
+        if (entry == nullptr) {
+            m_misses++;
+            return false;
+        }
+
+        m_hits++;
+        data = entry->data;
+        compressed = entry->compressed;
+    }
+
+    // shared copy is decoded outside of the lock, big articles don't block other lookups
+    if (compressed) {
+        article = QString::fromUtf8(qUncompress(data));
+    } else {
+        article = QString::fromUtf8(data);
+    }
+    return true;
+}
+
+void ZArticleCache::insert(const QString &word, quint32 generation, const QString &article)
+{
+    auto entry = std::make_unique<Entry>();
+    entry->data = article.toUtf8();
+
+    bool compression = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        compression = m_compression;
+    }
+
+    // compress outside of the lock, only keep compressed data when it is actually smaller
+    if (compression && entry->data.size() > CDefaults::articleCompressionThreshold) {
+        QByteArray packed = qCompress(entry->data,CDefaults::articleCompressionLevel);
+        if (packed.size() < entry->data.size()) {
+            entry->data = packed;
+            entry->compressed = true;
+        }
+    }
+
+    const ZArticleCacheKey key = qMakePair(generation,word);
+    const int cost = qMax(1,static_cast<int>(entry->data.size()));
+
+    QMutexLocker locker(&m_mutex);
+    const bool replaced = m_cache.contains(key);
+    const int before = m_cache.count();
+    if (m_cache.insert(key,entry.release(),cost)) {
+        m_insertions++;
+        const int expected = before + (replaced ? 0 : 1);
+        m_evictions += static_cast<quint64>(qMax(0,expected - m_cache.count()));
+    }
+}
+
+void ZArticleCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+}
+
+ZArticleCache::Statistics ZArticleCache::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    Statistics res;
+    res.hits = m_hits;
+    res.misses = m_misses;
+    res.insertions = m_insertions;
+    res.evictions = m_evictions;
+    res.usedBytes = m_cache.totalCost();
+    res.maxBytes = m_cache.maxCost();
+    res.count = m_cache.count();
+    return res;
+}
+
+double ZArticleCache::Statistics::hitRatio() const
+{
+    const quint64 total = hits + misses;
+    if (total == 0)
+        return 0.0;
+
+    return static_cast<double>(hits) / static_cast<double>(total);
+}
+
+QString ZArticleCache::Statistics::toString() const
+{
+    return QSL("Article cache: %1 entries, %2/%3 bytes, hit ratio %4% (%5 hits, %6 misses), "
+               "%7 insertions, %8 evictions")
+            .arg(count)
+            .arg(usedBytes)
+            .arg(maxBytes)
+            .arg(hitRatio()*100.0,0,'f',1)
+            .arg(hits)
+            .arg(misses)
+            .arg(insertions)
+            .arg(evictions);
+}
@@ -0,0 +1,59 @@
+#ifndef ARTICLECACHE_H
+#define ARTICLECACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QByteArray>
+
+using ZArticleCacheKey = QPair<quint32,QString>;
+
+class ZArticleCache : public QObject
+{
+    Q_OBJECT
+public:
+    class Statistics {
+    public:
+        quint64 hits { 0 };
+        quint64 misses { 0 };
+        quint64 insertions { 0 };
+        quint64 evictions { 0 };
+        qint64 usedBytes { 0 };
+        qint64 maxBytes { 0 };
+        int count { 0 };
+        double hitRatio() const;
+        QString toString() const;
+    };
+
+    explicit ZArticleCache(QObject *parent = nullptr);
+    ~ZArticleCache() override;
+
+    void setMaxBytes(qint64 bytes);
+    void setCompression(bool enabled);
+
+    bool lookup(const QString &word, quint32 generation, QString &article);
+    void insert(const QString &word, quint32 generation, const QString &article);
+    void clear();
+    Statistics statistics() const;
+
+private:
+    class Entry {
+    public:
+        QByteArray data;
+        bool compressed { false };
+    };
+
+    mutable QMutex m_mutex;
+    QCache<ZArticleCacheKey,Entry> m_cache;
+    bool m_compression { true };
+    quint64 m_hits { 0 };
+    quint64 m_misses { 0 };
+    quint64 m_insertions { 0 };
+    quint64 m_evictions { 0 };
+
+    Q_DISABLE_COPY(ZArticleCache)
+};
+
+#endif // ARTICLECACHE_H
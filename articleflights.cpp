@@ -0,0 +1,105 @@
+#include <QMutexLocker>
+#include "articleflights.h"
+
+ZArticleFlights::ZArticleFlights(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ZArticleFlights::~ZArticleFlights() = default;
+
+QString ZArticleFlights::load(const QString &word, quint32 generation, const QObject *requester,
+                              const Loader &loader)
+{
+    const ZArticleCacheKey key = qMakePair(generation,word);
+
+    QMutexLocker locker(&m_mutex);
+    m_requesters[requester].active++;
+    const quint64 epoch = cancelEpoch(requester);
+
+    QSharedPointer<Flight> flight = m_flights.value(key);
+    const bool leader = flight.isNull();
+    if (leader) {
+        flight = QSharedPointer<Flight>::create();
+        m_flights.insert(key,flight);
+    } else {
+        m_coalesced++;
+    }
+    flight->requesters[requester]++;
+
+    if (leader) {
+        // the controller call itself cannot be interrupted, result goes to the cache anyway
+        locker.unlock();
+        const QString res = loader(word);
+        locker.relock();
+
+        flight->result = res;
+        flight->done = true;
+        m_flights.remove(key);
+        flight->finished.wakeAll();
+    } else {
+        while (!flight->done && cancelEpoch(requester) == epoch)
+            flight->finished.wait(&m_mutex);
+    }
+
+    const bool cancelled = (cancelEpoch(requester) != epoch);
+    releaseRequester(requester);
+    if (cancelled)
+        return QString();
+
+    detach(flight.data(),requester);
+    return flight->result;
+}
+
+bool ZArticleFlights::cancel(const QObject *requester)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // epochs are kept only for requesters with loads in progress
+    auto it = m_requesters.find(requester);
+    if (it != m_requesters.end())
+        it.value().epoch++;
+
+    bool othersActive = false;
+    for (const auto &flight : std::as_const(m_flights)) {
+        flight->requesters.remove(requester);
+        if (!flight->requesters.isEmpty())
+            othersActive = true;
+        flight->finished.wakeAll();
+    }
+
+    return othersActive;
+}
+
+quint64 ZArticleFlights::coalescedRequests() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_coalesced;
+}
+
+quint64 ZArticleFlights::cancelEpoch(const QObject *requester) const
+{
+    return m_requesters.value(requester).epoch;
+}
+
+void ZArticleFlights::releaseRequester(const QObject *requester)
+{
+    auto it = m_requesters.find(requester);
+    if (it == m_requesters.end())
+        return;
+
+    it.value().active--;
+    if (it.value().active <= 0)
+        m_requesters.erase(it);
+}
+
+void ZArticleFlights::detach(Flight *flight, const QObject *requester)
+{
+    auto it = flight->requesters.find(requester);
+    if (it == flight->requesters.end())
+        return;
+
+    it.value()--;
+    if (it.value() <= 0)
+        flight->requesters.erase(it);
+}
@@ -0,0 +1,54 @@
+#ifndef ARTICLEFLIGHTS_H
+#define ARTICLEFLIGHTS_H
+
+#include <functional>
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QString>
+
+#include "articlecache.h"
+
+class ZArticleFlights : public QObject
+{
+    Q_OBJECT
+public:
+    using Loader = std::function<QString(const QString &word)>;
+
+    explicit ZArticleFlights(QObject *parent = nullptr);
+    ~ZArticleFlights() override;
+
+    QString load(const QString &word, quint32 generation, const QObject *requester, const Loader &loader);
+    bool cancel(const QObject *requester);
+    quint64 coalescedRequests() const;
+
+private:
+    class Flight {
+    public:
+        QString result;
+        bool done { false };
+        QHash<const QObject*,int> requesters;
+        QWaitCondition finished;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<ZArticleCacheKey,QSharedPointer<Flight> > m_flights;
+    class Requester {
+    public:
+        quint64 epoch { 0 };
+        int active { 0 };
+    };
+
+    QHash<const QObject*,Requester> m_requesters;
+    quint64 m_coalesced { 0 };
+
+    quint64 cancelEpoch(const QObject *requester) const;
+    void releaseRequester(const QObject *requester);
+    void detach(Flight *flight, const QObject *requester);
+
+    Q_DISABLE_COPY(ZArticleFlights)
+};
+
+#endif // ARTICLEFLIGHTS_H
@@ -0,0 +1,78 @@
+#include <QMutexLocker>
+#include "articleprefetcher.h"
+#include "global.h"
+
+ZArticlePrefetcher::ZArticlePrefetcher(QObject *parent)
+    : QObject(parent)
+{
+    m_thread = QThread::create([this]{
+        run();
+    });
+    m_thread->start(QThread::LowestPriority);
+}
+
+ZArticlePrefetcher::~ZArticlePrefetcher()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_terminate = true;
+        m_queue.clear();
+    }
+    m_wakeup.wakeAll();
+    m_thread->wait();
+    delete m_thread;
+}
+
+void ZArticlePrefetcher::prefetch(const QStringList &words)
+{
+    QMutexLocker locker(&m_mutex);
+    // newest request reflects what user is looking at, older queue is obsolete
+    m_queue = words;
+    m_queue.removeDuplicates();
+    m_queueGeneration = zF->dictGeneration();
+    m_wakeup.wakeAll();
+}
+
+void ZArticlePrefetcher::cancel()
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    locker.unlock();
+
+    zF->articleFlights->cancel(this);
+}
+
+void ZArticlePrefetcher::beginForeground()
+{
+    QMutexLocker locker(&m_mutex);
+    m_foregroundRequests++;
+}
+
+void ZArticlePrefetcher::endForeground()
+{
+    QMutexLocker locker(&m_mutex);
+    m_foregroundRequests--;
+    if (m_foregroundRequests == 0)
+        m_wakeup.wakeAll();
+}
+
+void ZArticlePrefetcher::run()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (!m_terminate) {
+        // yield to foreground lookups, they use the same dictionary controller
+        if (m_queue.isEmpty() || m_foregroundRequests > 0) {
+            m_wakeup.wait(&m_mutex);
+            continue;
+        }
+
+        const QString word = m_queue.takeFirst();
+        const quint32 generation = m_queueGeneration;
+
+        locker.unlock();
+        if (generation == zF->dictGeneration())
+            zF->loadArticle(word,this,false);
+        locker.relock();
+    }
+}
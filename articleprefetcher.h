@@ -0,0 +1,37 @@
+#ifndef ARTICLEPREFETCHER_H
+#define ARTICLEPREFETCHER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+#include <QThread>
+
+class ZArticlePrefetcher : public QObject
+{
+    Q_OBJECT
+private:
+    QMutex m_mutex;
+    QWaitCondition m_wakeup;
+    QStringList m_queue;
+    quint32 m_queueGeneration { 0 };
+    int m_foregroundRequests { 0 };
+    bool m_terminate { false };
+    QThread* m_thread { nullptr };
+
+    void run();
+
+public:
+    explicit ZArticlePrefetcher(QObject *parent = nullptr);
+    ~ZArticlePrefetcher() override;
+
+    void prefetch(const QStringList &words);
+    void beginForeground();
+    void endForeground();
+
+public Q_SLOTS:
+    void cancel();
+
+};
+
+#endif // ARTICLEPREFETCHER_H
@@ -0,0 +1,315 @@
+#include <deque>
+#include <cstdio>
+#include <cstring>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QSemaphore>
+#include <QThread>
+#include <QSharedPointer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QRegularExpression>
+#include <QDebug>
+
+#include "batchlookup.h"
+#include "dictquery.h"
+#include "global.h"
+#include "qsl.h"
+
+ZBatchLookup::ZBatchLookup(QObject *parent)
+    : QObject(parent)
+{
+    m_stdout.open(stdout,QIODevice::WriteOnly);
+}
+
+ZBatchLookup::~ZBatchLookup() = default;
+
+bool ZBatchLookup::isBatchArgument(const char *arg)
+{
+    static const char* const batchArgs[] = { "--radicals", "--kanji", "--word", "--stdin" };
+    for (const char* batchArg : batchArgs) {
+        if (matchesOption(arg,batchArg))
+            return true;
+    }
+    return false;
+}
+
+bool ZBatchLookup::matchesOption(const char *arg, const char *option)
+{
+    // QCommandLineParser accepts both "--option value" and "--option=value"
+    const size_t len = std::strlen(option);
+    return (std::strncmp(arg,option,len) == 0 && (arg[len] == '\0' || arg[len] == '=')); // NOLINT
+}
+
+int ZBatchLookup::exec(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QSL("QJRad command line lookup"));
+    parser.addHelpOption();
+    const QCommandLineOption radicalsOption(QSL("radicals"),QSL("Print kanji containing all <radicals>."),
+                                            QSL("radicals"));
+    const QCommandLineOption kanjiOption(QSL("kanji"),QSL("Print information about each of <kanji>."),
+                                         QSL("kanji"));
+    const QCommandLineOption wordOption(QSL("word"),QSL("Print dictionary article for <word>."),QSL("word"));
+    const QCommandLineOption stdinOption(QSL("stdin"),QSL("Read one query per line from stdin, "
+                                                          "write results as JSON lines."));
+    const QCommandLineOption methodOption(QSL("method"),QSL("Method for plain text stdin queries: "
+                                                            "article, lookup, segment, radicals or kanji."),
+                                          QSL("method"),QSL("article"));
+    const QCommandLineOption jsonOption(QSL("json"),QSL("Use JSON output for single queries too."));
+    parser.addOptions({ radicalsOption, kanjiOption, wordOption, stdinOption, methodOption, jsonOption });
+    parser.process(arguments);
+
+    m_jsonOutput = parser.isSet(jsonOption);
+    m_stdinMethod = parser.value(methodOption);
+
+    // stdin queries load kanji data on first radicals or kanji request
+    const bool needKanji = parser.isSet(radicalsOption) || parser.isSet(kanjiOption);
+    const bool needWords = parser.isSet(wordOption) || parser.isSet(stdinOption);
+
+    if (needKanji && !loadKanjiDictionary())
+        return 1;
+    if (needWords && !loadWordDictionaries())
+        return 1;
+
+    if (parser.isSet(radicalsOption)) {
+        QJsonObject request;
+        request.insert(QSL("method"),QSL("radicals"));
+        request.insert(QSL("query"),parser.value(radicalsOption));
+        writeReply(ZDictQuery::process(request,this));
+    }
+
+    if (parser.isSet(kanjiOption)) {
+        QJsonObject request;
+        request.insert(QSL("method"),QSL("kanji"));
+        request.insert(QSL("query"),parser.value(kanjiOption));
+        writeReply(ZDictQuery::process(request,this));
+    }
+
+    if (parser.isSet(wordOption)) {
+        QJsonObject request;
+        request.insert(QSL("method"),QSL("article"));
+        request.insert(QSL("query"),parser.value(wordOption));
+        writeReply(ZDictQuery::process(request,this));
+    }
+
+    if (parser.isSet(stdinOption))
+        return processStdin();
+
+    return 0;
+}
+
+bool ZBatchLookup::loadKanjiDictionary()
+{
+    auto *dict = new ZKanjiDictionary(this);
+    if (!dict->loadDictionaries(nullptr,false)) {
+        qCritical() << "Cannot load kanji dictionaries:" << dict->getErrorString();
+        return false;
+    }
+    zF->kanjiDictionary = dict;
+    return true;
+}
+
+bool ZBatchLookup::loadWordDictionaries()
+{
+    if (zF->getDictPaths().isEmpty()) {
+        qWarning() << "No word dictionaries configured";
+        return true;
+    }
+
+    // dictionaries are parsed by controller in background
+    QEventLoop loop;
+    connect(zF->dictManager,&ZDict::ZDictController::dictionariesLoaded,&loop,[&loop](const QString& message){
+        qInfo() << message;
+        loop.quit();
+    },Qt::QueuedConnection);
+    zF->loadDictionaries();
+    loop.exec();
+    return true;
+}
+
+QJsonObject ZBatchLookup::malformedRequest(const QString &line)
+{
+    QJsonObject res;
+    static const QRegularExpression idRx(QSL(R"("id"\s*:\s*("(?:[^"\\]|\\.)*"|-?\d+))"));
+    const QRegularExpressionMatch match = idRx.match(line);
+    if (!match.hasMatch())
+        return res;
+
+    const QJsonArray value = QJsonDocument::fromJson(QSL("[%1]").arg(match.captured(1)).toUtf8()).array();
+    if (!value.isEmpty())
+        res.insert(QSL("id"),value.first());
+    return res;
+}
+
+void ZBatchLookup::write(const QByteArray &data)
+{
+    m_stdout.write(data);
+    m_stdout.flush();
+}
+
+void ZBatchLookup::writeReply(const QJsonObject &reply)
+{
+    if (m_jsonOutput || reply.contains(QSL("error"))) {
+        QByteArray data = QJsonDocument(reply).toJson(QJsonDocument::Compact);
+        data.append('\n');
+        write(data);
+        return;
+    }
+
+    QString res;
+    if (reply.contains(QSL("article"))) {
+        res = reply.value(QSL("article")).toString();
+    } else if (reply.value(QSL("kanji")).isString()) {
+        res = reply.value(QSL("kanji")).toString();
+    } else if (reply.value(QSL("kanji")).isArray()) {
+        const QJsonArray list = reply.value(QSL("kanji")).toArray();
+        for (const auto &item : list) {
+            const QJsonObject ki = item.toObject();
+            if (!ki.value(QSL("found")).toBool()) {
+                res.append(QSL("%1: not found\n").arg(ki.value(QSL("kanji")).toString()));
+                continue;
+            }
+            QStringList on;
+            QStringList kun;
+            QStringList meaning;
+            for (const auto &v : ki.value(QSL("on")).toArray())
+                on.append(v.toString());
+            for (const auto &v : ki.value(QSL("kun")).toArray())
+                kun.append(v.toString());
+            for (const auto &v : ki.value(QSL("meaning")).toArray())
+                meaning.append(v.toString());
+            res.append(QSL("%1\nStrokes: %2\nGrade: %3\nParts: %4\nOn: %5\nKun: %6\nMeaning: %7\n")
+                       .arg(ki.value(QSL("kanji")).toString())
+                       .arg(ki.value(QSL("strokes")).toInt())
+                       .arg(ki.value(QSL("grade")).toInt())
+                       .arg(ki.value(QSL("parts")).toString(),
+                            on.join(QSL(", ")),
+                            kun.join(QSL(", ")),
+                            meaning.join(QSL(", "))));
+        }
+    }
+
+    if (!res.endsWith(QChar('\n')))
+        res.append(QChar('\n'));
+    write(res.toUtf8());
+}
+
+int ZBatchLookup::processStdin()
+{
+    class Slot {
+    public:
+        QByteArray output;
+        QSemaphore ready;
+    };
+
+    QTextStream in(stdin);
+#if QT_VERSION < QT_VERSION_CHECK(6,0,0)
+    in.setCodec("UTF-8");
+#endif
+
+    // results are written strictly in input order, window size is bounded by worker queue
+    std::deque<QSharedPointer<Slot> > window;
+    const auto windowSize = static_cast<size_t>(qMax(1,zF->dictWorkers->maxPendingTasks()));
+    qint64 queries = 0;
+    qint64 lineNumber = 0;
+
+    auto flush = [this,&window](bool wait){
+        while (!window.empty()) {
+            if (wait) {
+                window.front()->ready.acquire();
+            } else if (!window.front()->ready.tryAcquire()) {
+                break;
+            }
+            write(window.front()->output);
+            window.pop_front();
+            wait = false;
+        }
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        lineNumber++;
+        if (line.isEmpty())
+            continue;
+
+        QJsonObject request;
+        QString parseError;
+        if (line.startsWith(QChar('{'))) {
+            QJsonParseError error {};
+            const QJsonDocument doc = QJsonDocument::fromJson(line.toUtf8(),&error);
+            if (error.error != QJsonParseError::NoError) {
+                parseError = error.errorString();
+            } else if (!doc.isObject()) {
+                parseError = QSL("Request is not a JSON object");
+            } else {
+                request = doc.object();
+            }
+        } else {
+            request.insert(QSL("id"),queries);
+            request.insert(QSL("method"),m_stdinMethod);
+            request.insert(QSL("query"),line);
+        }
+        queries++;
+
+        if (window.size() >= windowSize)
+            flush(true);
+
+        auto slot = QSharedPointer<Slot>::create();
+
+        if (!parseError.isEmpty()) {
+            // caller still needs something to match the error with
+            QJsonObject reply = ZDictQuery::errorReply(malformedRequest(line),
+                                                       QSL("Malformed request: %1").arg(parseError));
+            reply.insert(QSL("line"),lineNumber);
+            slot->output = QJsonDocument(reply).toJson(QJsonDocument::Compact);
+            slot->output.append('\n');
+            slot->ready.release();
+            window.push_back(slot);
+            flush(false);
+            continue;
+        }
+
+        const QString method = request.value(QSL("method")).toString();
+        if (!m_kanjiRequested && (method == QSL("radicals") || method == QSL("kanji"))) {
+            // failed load is reported once, queries are answered with dictionary error
+            m_kanjiRequested = true;
+            loadKanjiDictionary();
+        }
+
+        while (!zF->dictWorkers->tryStart([this,request,slot]{
+            QByteArray data = QJsonDocument(ZDictQuery::process(request,this)).toJson(QJsonDocument::Compact);
+            data.append('\n');
+            slot->output = data;
+            slot->ready.release();
+        })) {
+            // worker queue is shared with D-Bus and socket clients
+            if (window.empty()) {
+                QThread::msleep(1);
+            } else {
+                flush(true);
+            }
+        }
+        window.push_back(slot);
+
+        flush(false);
+    }
+
+    while (!window.empty())
+        flush(true);
+
+    const double elapsed = static_cast<double>(timer.nsecsElapsed()) / 1.0e9;
+    qInfo().noquote() << QSL("Processed %1 queries in %2 s (%3 queries/s) on %4 threads")
+                         .arg(queries)
+                         .arg(elapsed,0,'f',3)
+                         .arg(elapsed > 0.0 ? static_cast<double>(queries) / elapsed : 0.0,0,'f',1)
+                         .arg(zF->dictWorkers->maxThreads());
+    qInfo().noquote() << zF->articleCache->statistics().toString();
+
+    return 0;
+}
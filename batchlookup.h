@@ -0,0 +1,37 @@
+#ifndef BATCHLOOKUP_H
+#define BATCHLOOKUP_H
+
+#include <QObject>
+#include <QFile>
+#include <QJsonObject>
+#include <QStringList>
+
+class ZKanjiDictionary;
+
+class ZBatchLookup : public QObject
+{
+    Q_OBJECT
+private:
+    QFile m_stdout;
+    QString m_stdinMethod;
+    bool m_jsonOutput { false };
+    bool m_kanjiRequested { false };
+
+    bool loadKanjiDictionary();
+    static QJsonObject malformedRequest(const QString &line);
+    void write(const QByteArray &data);
+    void writeReply(const QJsonObject &reply);
+    int processStdin();
+
+public:
+    explicit ZBatchLookup(QObject *parent = nullptr);
+    ~ZBatchLookup() override;
+
+    int exec(const QStringList &arguments);
+    static bool isBatchArgument(const char *arg);
+    static bool matchesOption(const char *arg, const char *option);
+    static bool loadWordDictionaries();
+
+};
+
+#endif // BATCHLOOKUP_H
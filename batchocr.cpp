@@ -0,0 +1,262 @@
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QThread>
+#include <QDebug>
+
+#include "batchocr.h"
+#include "batchlookup.h"
+#include "dictquery.h"
+#include "dictworkerpool.h"
+#include "ocrservice.h"
+#include "global.h"
+#include "qsl.h"
+
+#ifdef WITH_OCR
+
+namespace CDefaults {
+const int batchOCRJobsPerEngine = 2;
+const int batchOCRSegmentRetryMS = 10;
+}
+
+ZBatchOCR::ZBatchOCR(QObject *parent)
+    : QObject(parent)
+{
+    m_stdout.open(stdout,QIODevice::WriteOnly);
+}
+
+ZBatchOCR::~ZBatchOCR()
+{
+    if (m_service)
+        m_service->stop();
+}
+
+int ZBatchOCR::exec(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QSL("QJRad batch OCR"));
+    parser.addHelpOption();
+    const QCommandLineOption ocrOption(QSL("ocr"),QSL("Recognize text in image files and directories, "
+                                                      "write results as JSON lines."));
+    const QCommandLineOption enginesOption(QSL("engines"),QSL("Number of parallel Tesseract engines "
+                                                              "(default: number of CPU cores)."),
+                                           QSL("count"),QString::number(QThread::idealThreadCount()));
+    const QCommandLineOption languageOption(QSL("language"),QSL("Tesseract language (default: active OCR language)."),
+                                            QSL("language"),zF->ocrGetActiveLanguage());
+    const QCommandLineOption segmentOption(QSL("segment"),QSL("Split recognized text into dictionary words."));
+    parser.addOptions({ ocrOption, enginesOption, languageOption, segmentOption });
+    parser.addPositionalArgument(QSL("paths"),QSL("Image files or directories."),QSL("paths..."));
+    parser.process(arguments);
+
+    m_files = collectFiles(parser.positionalArguments());
+    if (m_files.isEmpty()) {
+        qCritical() << "No image files to recognize";
+        return 1;
+    }
+
+    m_segment = parser.isSet(segmentOption);
+    if (m_segment && !ZBatchLookup::loadWordDictionaries())
+        return 1;
+
+    const int engines = qMax(1,parser.value(enginesOption).toInt());
+    m_window = engines * CDefaults::batchOCRJobsPerEngine;
+
+    m_service = new ZOCRService(this);
+    m_service->setPreprocessOptions(ZOCRPreprocessor::Options::fromSettings());
+    connect(m_service,&ZOCRService::started,this,&ZBatchOCR::started,Qt::QueuedConnection);
+    connect(m_service,&ZOCRService::recognized,this,&ZBatchOCR::recognized,Qt::QueuedConnection);
+    connect(m_service,&ZOCRService::failed,this,&ZBatchOCR::failed,Qt::QueuedConnection);
+    connect(m_service,&ZOCRService::timings,this,&ZBatchOCR::timings,Qt::QueuedConnection);
+    m_service->start(engines,zF->ocrGetDatapath(),parser.value(languageOption));
+
+    m_segmentRetry.setSingleShot(true);
+    m_segmentRetry.setInterval(CDefaults::batchOCRSegmentRetryMS);
+    connect(&m_segmentRetry,&QTimer::timeout,this,&ZBatchOCR::startSegmentation);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QEventLoop loop;
+    m_loop = &loop;
+    submitNext();
+    if (m_pending > 0)
+        loop.exec();
+    m_loop = nullptr;
+
+    m_service->stop();
+
+    // jobs dropped by service without answer are reported, not waited for
+    for (auto it = m_jobs.constBegin(), end = m_jobs.constEnd(); it != end; ++it) {
+        QJsonObject result;
+        result.insert(QSL("file"),it.value().fileName);
+        result.insert(QSL("error"),QSL("OCR job was lost"));
+        m_failed++;
+        write(result);
+    }
+    m_jobs.clear();
+
+    const double elapsed = static_cast<double>(timer.nsecsElapsed()) / 1.0e9;
+    qInfo().noquote() << QSL("Recognized %1 images (%2 failed) in %3 s (%4 images/s) on %5 engines")
+                         .arg(m_processed)
+                         .arg(m_failed)
+                         .arg(elapsed,0,'f',3)
+                         .arg(elapsed > 0.0 ? static_cast<double>(m_processed) / elapsed : 0.0,0,'f',2)
+                         .arg(engines);
+
+    return (m_failed > 0) ? 2 : 0;
+}
+
+QStringList ZBatchOCR::collectFiles(const QStringList &paths)
+{
+    QStringList filters;
+    const QList<QByteArray> formats = QImageReader::supportedImageFormats();
+    filters.reserve(formats.count());
+    for (const auto &format : formats)
+        filters.append(QSL("*.%1").arg(QString::fromLatin1(format)));
+
+    QStringList res;
+    for (const auto &path : paths) {
+        const QFileInfo fi(path);
+        if (fi.isDir()) {
+            QStringList dirFiles;
+            QDirIterator it(path,filters,QDir::Files | QDir::Readable,QDirIterator::Subdirectories);
+            while (it.hasNext())
+                dirFiles.append(it.next());
+            // frame dumps are usually numbered, keep natural capture order
+            dirFiles.sort();
+            res.append(dirFiles);
+        } else if (fi.isFile()) {
+            res.append(path);
+        } else {
+            qWarning() << "File not found:" << path;
+        }
+    }
+    return res;
+}
+
+void ZBatchOCR::submitNext()
+{
+    // bounded number of decoded images waiting in OCR queue
+    while (m_pending < m_window && m_nextFile < m_files.count()) {
+        const QString fileName = m_files.at(m_nextFile++);
+
+        Item item;
+        item.fileName = fileName;
+        item.timer.start();
+
+        QImage image(fileName);
+        if (image.isNull()) {
+            QJsonObject result;
+            result.insert(QSL("file"),fileName);
+            result.insert(QSL("error"),QSL("Unable to load image"));
+            m_failed++;
+            write(result);
+            continue;
+        }
+
+        const quint64 jobId = m_service->recognize(image);
+        m_jobs.insert(jobId,item);
+        m_pending++;
+    }
+
+    if (m_pending == 0 && m_nextFile >= m_files.count() && m_loop)
+        m_loop->quit();
+}
+
+void ZBatchOCR::started(quint64 jobId, qint64 queueWaitNS)
+{
+    auto it = m_jobs.find(jobId);
+    if (it != m_jobs.end())
+        it.value().queueWaitNS = queueWaitNS;
+}
+
+void ZBatchOCR::recognized(quint64 jobId, const QString &text)
+{
+    if (!m_jobs.contains(jobId))
+        return;
+    const Item item = m_jobs.take(jobId);
+
+    // engine queue wait is reported apart from recognition time
+    const qint64 totalNS = item.timer.nsecsElapsed();
+    QJsonObject result;
+    result.insert(QSL("file"),item.fileName);
+    result.insert(QSL("text"),text);
+    result.insert(QSL("queueMs"),static_cast<double>(item.queueWaitNS) / 1.0e6);
+    result.insert(QSL("ms"),static_cast<double>(totalNS - item.queueWaitNS) / 1.0e6);
+    result.insert(QSL("timings"),item.timings);
+    m_processed++;
+
+    if (!m_segment || text.isEmpty()) {
+        finishItem(result);
+        return;
+    }
+
+    m_segmentQueue.append(result);
+    startSegmentation();
+}
+
+void ZBatchOCR::startSegmentation()
+{
+    // dictionary lookups run on shared workers, OCR engines keep going meanwhile
+    while (!m_segmentQueue.isEmpty()) {
+        const QJsonObject result = m_segmentQueue.first();
+        const bool accepted = zF->dictWorkers->tryStart([this,result]{
+            QJsonObject res = result;
+            const QString text = res.value(QSL("text")).toString();
+            res.insert(QSL("words"),QJsonArray::fromStringList(ZDictQuery::segmentText(text)));
+            QMetaObject::invokeMethod(this,[this,res]{
+                finishItem(res);
+            },Qt::QueuedConnection);
+        });
+        if (!accepted) {
+            // worker queue is shared with other clients, try again later without blocking event loop
+            if (!m_segmentRetry.isActive())
+                m_segmentRetry.start();
+            return;
+        }
+        m_segmentQueue.removeFirst();
+    }
+}
+
+void ZBatchOCR::failed(quint64 jobId, const QString &error)
+{
+    if (!m_jobs.contains(jobId))
+        return;
+    const Item item = m_jobs.take(jobId);
+
+    QJsonObject result;
+    result.insert(QSL("file"),item.fileName);
+    result.insert(QSL("error"),error);
+    m_failed++;
+    finishItem(result);
+}
+
+void ZBatchOCR::timings(quint64 jobId, const QString &report)
+{
+    auto it = m_jobs.find(jobId);
+    if (it != m_jobs.end())
+        it.value().timings = report;
+}
+
+void ZBatchOCR::finishItem(const QJsonObject &result)
+{
+    write(result);
+    m_pending--;
+    startSegmentation();
+    submitNext();
+}
+
+void ZBatchOCR::write(const QJsonObject &result)
+{
+    QByteArray data = QJsonDocument(result).toJson(QJsonDocument::Compact);
+    data.append('\n');
+    m_stdout.write(data);
+    m_stdout.flush();
+}
+
+#endif // WITH_OCR
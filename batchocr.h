@@ -0,0 +1,66 @@
+#ifndef BATCHOCR_H
+#define BATCHOCR_H
+
+#ifdef WITH_OCR
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QList>
+
+class QEventLoop;
+class ZOCRService;
+
+class ZBatchOCR : public QObject
+{
+    Q_OBJECT
+private:
+    class Item {
+    public:
+        QString fileName;
+        QString timings;
+        QElapsedTimer timer;
+        qint64 queueWaitNS { 0 };
+    };
+
+    QFile m_stdout;
+    ZOCRService* m_service { nullptr };
+    QEventLoop* m_loop { nullptr };
+    QStringList m_files;
+    QHash<quint64,Item> m_jobs;
+    QList<QJsonObject> m_segmentQueue;
+    QTimer m_segmentRetry;
+    int m_nextFile { 0 };
+    int m_pending { 0 };
+    int m_window { 1 };
+    int m_processed { 0 };
+    int m_failed { 0 };
+    bool m_segment { false };
+
+    static QStringList collectFiles(const QStringList &paths);
+    void submitNext();
+    void startSegmentation();
+    void finishItem(const QJsonObject &result);
+    void write(const QJsonObject &result);
+
+private Q_SLOTS:
+    void started(quint64 jobId, qint64 queueWaitNS);
+    void recognized(quint64 jobId, const QString &text);
+    void failed(quint64 jobId, const QString &error);
+    void timings(quint64 jobId, const QString &report);
+
+public:
+    explicit ZBatchOCR(QObject *parent = nullptr);
+    ~ZBatchOCR() override;
+
+    int exec(const QStringList &arguments);
+
+};
+
+#endif // WITH_OCR
+
+#endif // BATCHOCR_H
@@ -1,11 +1,16 @@
+#include <vector>
 #include <QString>
-#include <QThread>
+#include <QHash>
+#include <QSharedPointer>
+#include <QDebug>
 
 #include "dbusdict.h"
 #include "mainwindow.h"
+#include "global.h"
+#include "qsl.h"
 
 ZKanjiDBusDict::ZKanjiDBusDict(QObject *parent, ZDict::ZDictController *dictManager) :
-    QObject(parent), m_wnd(nullptr)
+    QObject(parent)
 {
     m_dictManager = dictManager;
 }
@@ -17,18 +22,125 @@ void ZKanjiDBusDict::setMainWindow(ZMainWindow *wnd)
 
 void ZKanjiDBusDict::findWordTranslation(const QString &text)
 {
-    QThread *th = QThread::create([this,text]{
-        QString res = m_dictManager->loadArticle(text);
+    const bool accepted = zF->dictWorkers->tryStart([this,text]{
+        QString res = zF->loadArticle(text,this);
         Q_EMIT gotWordTranslation(res);
     });
-    connect(th,&QThread::finished,th,&QThread::deleteLater);
-    th->start();
+
+    if (!accepted) {
+        qWarning() << "D-Bus translation queue is full, request dropped";
+        // legacy clients wait for any reply, so answer with empty article
+        Q_EMIT gotWordTranslation(QString());
+    }
+}
+
+bool ZKanjiDBusDict::findWordTranslationRequest(uint requestId, const QString &text)
+{
+    const bool accepted = zF->dictWorkers->tryStart([this,requestId,text]{
+        QString res = zF->loadArticle(text,this);
+        Q_EMIT gotWordTranslationReply(requestId,res);
+    });
+
+    if (!accepted) {
+        Q_EMIT wordTranslationFailed(requestId,tr("Request queue is full (%1 pending), try again later.")
+                                     .arg(zF->dictWorkers->pendingTasks()));
+    }
+
+    return accepted;
+}
+
+bool ZKanjiDBusDict::findWordTranslations(uint requestId, const QStringList &words)
+{
+    class BatchState {
+    public:
+        QStringList words;
+        QStringList uniqueWords;
+        QVector<int> wordIndex;
+        std::vector<QString> articles;
+        QAtomicInt remaining { 0 };
+    };
+
+    auto state = QSharedPointer<BatchState>::create();
+    state->words = words;
+    state->wordIndex.reserve(words.count());
+
+    // repeated tokens in one sentence are looked up only once
+    QHash<QString,int> uniqueIndex;
+    for (const auto &word : words) {
+        auto it = uniqueIndex.constFind(word);
+        if (it == uniqueIndex.constEnd()) {
+            it = uniqueIndex.insert(word,state->uniqueWords.count());
+            state->uniqueWords.append(word);
+        }
+        state->wordIndex.append(it.value());
+    }
+    state->articles.resize(static_cast<size_t>(state->uniqueWords.count()));
+    state->remaining.storeRelease(state->uniqueWords.count());
+
+    if (state->uniqueWords.isEmpty()) {
+        Q_EMIT gotWordTranslationsReply(requestId,words,QStringList());
+        return true;
+    }
+
+    QVector<std::function<void()> > tasks;
+    tasks.reserve(state->uniqueWords.count());
+    for (int i=0; i<state->uniqueWords.count(); i++) {
+        tasks.append([this,requestId,state,i]{
+            state->articles[static_cast<size_t>(i)] = zF->loadArticle(state->uniqueWords.at(i),this);
+            if (!state->remaining.deref()) {
+                QStringList articles;
+                articles.reserve(state->wordIndex.count());
+                for (const int idx : std::as_const(state->wordIndex))
+                    articles.append(state->articles.at(static_cast<size_t>(idx)));
+                Q_EMIT gotWordTranslationsReply(requestId,state->words,articles);
+            }
+        });
+    }
+
+    const bool accepted = zF->dictWorkers->tryStartBatch(tasks);
+    if (!accepted) {
+        Q_EMIT wordTranslationFailed(requestId,tr("Request queue is full (%1 pending), try again later.")
+                                     .arg(zF->dictWorkers->pendingTasks()));
+    }
+
+    return accepted;
 }
 
 void ZKanjiDBusDict::showDictionaryWindow(const QString &text)
 {
+    if (m_wnd.isNull()) {
+        qWarning() << "showDictionaryWindow is not available in headless mode";
+        return;
+    }
+
     m_wnd->showNormal();
     m_wnd->raise();
     m_wnd->activateWindow();
     m_wnd->setScratchPadText(text);
 }
+
+void ZKanjiDBusDict::captureWindowUnderCursor()
+{
+    if (m_wnd.isNull()) {
+        qWarning() << "captureWindowUnderCursor is not available in headless mode";
+        return;
+    }
+
+    m_wnd->captureWindowUnderCursor();
+}
+
+QString ZKanjiDBusDict::articleCacheStatistics()
+{
+    return QSL("%1, %2 coalesced requests")
+            .arg(zF->articleCache->statistics().toString())
+            .arg(zF->articleFlights->coalescedRequests());
+}
+
+QString ZKanjiDBusDict::ocrCacheStatistics()
+{
+#ifdef WITH_OCR
+    if (zF->ocrCache)
+        return zF->ocrCache->statistics().toString();
+#endif
+    return QSL("OCR is not available");
+}
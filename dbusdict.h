@@ -2,6 +2,8 @@
 #define DBUSDICT_H
 
 #include <QObject>
+#include <QStringList>
+#include <QPointer>
 #include "zdict/zdictcontroller.h"
 
 class ZMainWindow;
@@ -12,7 +14,7 @@ class ZKanjiDBusDict : public QObject
     Q_CLASSINFO("D-Bus Interface", "org.qjrad.dictionary")
 private:
     ZDict::ZDictController* m_dictManager;
-    ZMainWindow* m_wnd;
+    QPointer<ZMainWindow> m_wnd;
 
 public:
     explicit ZKanjiDBusDict(QObject *parent, ZDict::ZDictController* dictManager);
@@ -20,10 +22,19 @@ public:
 
 Q_SIGNALS:
     Q_SCRIPTABLE void gotWordTranslation(const QString& html);
+    Q_SCRIPTABLE void gotWordTranslationReply(uint requestId, const QString& html);
+    Q_SCRIPTABLE void wordTranslationFailed(uint requestId, const QString& error);
+    Q_SCRIPTABLE void gotWordTranslationsReply(uint requestId, const QStringList& words,
+                                               const QStringList& articles);
 
 public Q_SLOTS:
     void findWordTranslation(const QString& text);
+    bool findWordTranslationRequest(uint requestId, const QString& text);
+    bool findWordTranslations(uint requestId, const QStringList& words);
     void showDictionaryWindow(const QString& text);
+    void captureWindowUnderCursor();
+    QString articleCacheStatistics();
+    QString ocrCacheStatistics();
 
 };
 
@@ -0,0 +1,122 @@
+#include <QJsonArray>
+#include <QSettings>
+#include "dictquery.h"
+#include "global.h"
+#include "qsl.h"
+
+namespace CDefaults {
+const int segmentMaxWordLength = 12;
+const int segmentLookupLimit = 16;
+}
+
+QJsonObject ZDictQuery::process(const QJsonObject &request, const QObject *requester)
+{
+    const QString method = request.value(QSL("method")).toString();
+    const QString query = request.value(QSL("query")).toString();
+
+    QJsonObject res;
+    const QJsonValue id = request.value(QSL("id"));
+    if (!id.isUndefined())
+        res.insert(QSL("id"),id);
+
+    if (query.isEmpty())
+        return errorReply(request,QSL("Empty query"));
+
+    if (method == QSL("lookup")) {
+        QSettings stg;
+        stg.beginGroup(QSL("Main"));
+        const int maxDictionaryResults = stg.value(QSL("maxDictionaryResults"),
+                                                   CDefaults::maxDictionaryResults).toInt();
+        stg.endGroup();
+        const int limit = request.value(QSL("limit")).toInt(maxDictionaryResults);
+
+        res.insert(QSL("words"),QJsonArray::fromStringList(zF->dictManager->wordLookup(query,false,limit)));
+        return res;
+    }
+
+    if (method == QSL("segment")) {
+        res.insert(QSL("words"),QJsonArray::fromStringList(segmentText(query)));
+        return res;
+    }
+
+    if (method == QSL("article")) {
+        res.insert(QSL("article"),zF->loadArticle(query,requester));
+        return res;
+    }
+
+    ZKanjiDictionary* dict = zF->kanjiDictionary.data();
+    if (dict == nullptr)
+        return errorReply(request,QSL("Kanji dictionary is not loaded"));
+
+    if (method == QSL("radicals")) {
+        res.insert(QSL("kanji"),dict->sortKanji(dict->lookupRadicals(query)));
+        return res;
+    }
+
+    if (method == QSL("kanji")) {
+        QJsonArray list;
+        for (const QChar &kanji : query)
+            list.append(kanjiInfoToJson(dict,kanji));
+        res.insert(QSL("kanji"),list);
+        return res;
+    }
+
+    return errorReply(request,QSL("Unknown method '%1'").arg(method));
+}
+
+QStringList ZDictQuery::segmentText(const QString &text)
+{
+    // greedy longest match against word dictionaries, unknown characters are kept as is
+    QStringList res;
+    int pos = 0;
+    while (pos < text.length()) {
+        if (text.at(pos).isSpace() || text.at(pos).isPunct()) {
+            pos++;
+            continue;
+        }
+
+        int matched = 1;
+        for (int len = qMin(CDefaults::segmentMaxWordLength,text.length() - pos); len > 1; len--) {
+            const QString candidate = text.mid(pos,len);
+            if (zF->dictManager->wordLookup(candidate,false,CDefaults::segmentLookupLimit).contains(candidate)) {
+                matched = len;
+                break;
+            }
+        }
+
+        res.append(text.mid(pos,matched));
+        pos += matched;
+    }
+    return res;
+}
+
+QJsonObject ZDictQuery::errorReply(const QJsonObject &request, const QString &error)
+{
+    QJsonObject res;
+    const QJsonValue id = request.value(QSL("id"));
+    if (!id.isUndefined())
+        res.insert(QSL("id"),id);
+    res.insert(QSL("error"),error);
+    return res;
+}
+
+QJsonObject ZDictQuery::kanjiInfoToJson(ZKanjiDictionary *dict, QChar kanji)
+{
+    QJsonObject res;
+    res.insert(QSL("kanji"),QString(kanji));
+
+    const ZKanjiInfo ki = dict->getKanjiInfo(kanji);
+    if (ki.isEmpty()) {
+        res.insert(QSL("found"),false);
+        return res;
+    }
+
+    res.insert(QSL("found"),true);
+    res.insert(QSL("strokes"),dict->getKanjiStrokes(kanji));
+    res.insert(QSL("grade"),dict->getKanjiGrade(kanji));
+    res.insert(QSL("parts"),dict->getKanjiParts(kanji));
+    res.insert(QSL("on"),QJsonArray::fromStringList(ki.onReading));
+    res.insert(QSL("kun"),QJsonArray::fromStringList(ki.kunReading));
+    res.insert(QSL("meaning"),QJsonArray::fromStringList(ki.meaning));
+    return res;
+}
@@ -0,0 +1,22 @@
+#ifndef DICTQUERY_H
+#define DICTQUERY_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include "kdictionary.h"
+
+class ZDictQuery
+{
+public:
+    static QJsonObject process(const QJsonObject &request, const QObject *requester);
+    static QJsonObject errorReply(const QJsonObject &request, const QString &error);
+    static QJsonObject kanjiInfoToJson(ZKanjiDictionary *dict, QChar kanji);
+    static QStringList segmentText(const QString &text);
+
+private:
+    ZDictQuery() = default;
+};
+
+#endif // DICTQUERY_H
@@ -0,0 +1,86 @@
+#include <QSharedPointer>
+#include "dictworkerpool.h"
+
+ZDictWorkerPool::ZDictWorkerPool(QObject *parent, int maxThreads, int maxPending)
+    : QObject(parent),
+      m_maxPending(maxPending)
+{
+    m_pool = new QThreadPool(this);
+    m_pool->setMaxThreadCount(qMax(1,maxThreads));
+}
+
+ZDictWorkerPool::~ZDictWorkerPool()
+{
+    waitForDone();
+}
+
+bool ZDictWorkerPool::reserve(int count)
+{
+    // pending counter covers both queued and running tasks
+    int pending = m_pending.loadAcquire();
+    do {
+        if (pending + count > m_maxPending)
+            return false;
+    } while (!m_pending.testAndSetOrdered(pending,pending + count,pending));
+
+    return true;
+}
+
+void ZDictWorkerPool::startReserved(const std::function<void()> &task)
+{
+    m_pool->start([this,task]{
+        task();
+        m_pending.fetchAndSubOrdered(1);
+    });
+}
+
+bool ZDictWorkerPool::tryStart(const std::function<void()> &task)
+{
+    if (!reserve(1))
+        return false;
+
+    startReserved(task);
+    return true;
+}
+
+bool ZDictWorkerPool::tryStartBatch(const QVector<std::function<void()> > &tasks)
+{
+    if (tasks.isEmpty())
+        return true;
+
+    // batch is accepted or rejected as a whole, but it is drained by at most one runner
+    // per thread, so batches longer than the queue limit still fit into an idle pool
+    const int runners = qMin(tasks.count(),qMin(maxThreads(),m_maxPending));
+    if (!reserve(runners))
+        return false;
+
+    auto next = QSharedPointer<QAtomicInt>::create(0);
+    for (int i = 0; i < runners; i++) {
+        startReserved([tasks,next]{
+            for (int idx = next->fetchAndAddOrdered(1); idx < tasks.count(); idx = next->fetchAndAddOrdered(1))
+                tasks.at(idx)();
+        });
+    }
+
+    return true;
+}
+
+void ZDictWorkerPool::waitForDone()
+{
+    m_pool->waitForDone();
+}
+
+int ZDictWorkerPool::pendingTasks() const
+{
+    return m_pending.loadAcquire();
+}
+
+int ZDictWorkerPool::maxPendingTasks() const
+{
+    return m_maxPending;
+}
+
+int ZDictWorkerPool::maxThreads() const
+{
+    return m_pool->maxThreadCount();
+}
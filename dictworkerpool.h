@@ -0,0 +1,34 @@
+#ifndef DICTWORKERPOOL_H
+#define DICTWORKERPOOL_H
+
+#include <functional>
+#include <QVector>
+#include <QObject>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+class ZDictWorkerPool : public QObject
+{
+    Q_OBJECT
+private:
+    QThreadPool* m_pool { nullptr };
+    QAtomicInt m_pending { 0 };
+    int m_maxPending { 0 };
+
+    bool reserve(int count);
+    void startReserved(const std::function<void()> &task);
+
+public:
+    ZDictWorkerPool(QObject *parent, int maxThreads, int maxPending);
+    ~ZDictWorkerPool() override;
+
+    bool tryStart(const std::function<void()> &task);
+    bool tryStartBatch(const QVector<std::function<void()> > &tasks);
+    void waitForDone();
+    int pendingTasks() const;
+    int maxPendingTasks() const;
+    int maxThreads() const;
+
+};
+
+#endif // DICTWORKERPOOL_H
@@ -2,6 +2,8 @@
 #include <QMessageBox>
 #include <QSettings>
 #include <QDBusConnection>
+#include <QThread>
+#include <QStandardPaths>
 #include "global.h"
 #include "qsl.h"
 #include "mainwindow.h"
@@ -11,21 +13,48 @@
 namespace CDefaults {
 const int kanjiFontSize = 14;
 const int labelFontSize = 12;
+const bool localSocketEnabled = false;
+const char localSocketName[] = "qjrad";
+const int articleInterruptRetries = 2;
 }
 
 ZGlobal::ZGlobal(QObject *parent) :
     QObject(parent)
 {
     dictManager = new ZDict::ZDictController(this);
+    articleCache = new ZArticleCache(this);
+
+    // lookups made while controller was still loading saw partial dictionary set
+    connect(dictManager,&ZDict::ZDictController::dictionariesLoaded,this,[this](){
+        invalidateDictionaryResults();
+    },Qt::DirectConnection);
+    articleFlights = new ZArticleFlights(this);
+    articlePrefetcher = new ZArticlePrefetcher(this);
+    dictWorkers = new ZDictWorkerPool(this,QThread::idealThreadCount(),CDefaults::dictWorkerQueueLimit);
+    localServer = new ZLocalQueryServer(this);
 
     dbusDict = new ZKanjiDBusDict(this,dictManager);
     new DictionaryAdaptor(dbusDict);
     QDBusConnection dbus = QDBusConnection::sessionBus();
-    dbus.registerObject(QSL("/"),dbusDict);
-    dbus.registerService(QSL("org.qjrad.dictionary"));
+    m_dbusRegistered = dbus.registerObject(QSL("/"),dbusDict) &&
+                       dbus.registerService(QSL("org.qjrad.dictionary"));
 }
 
-ZGlobal::~ZGlobal() = default;
+ZGlobal::~ZGlobal()
+{
+    // stop background workers before the cache and controller are gone
+    localServer->close();
+#ifdef WITH_OCR
+    if (ocrService)
+        ocrService->stop();
+    if (ocrCache)
+        ocrCache->save();
+#endif
+    delete dictWorkers;
+    dictWorkers = nullptr;
+    delete articlePrefetcher;
+    articlePrefetcher = nullptr;
+}
 
 ZGlobal *ZGlobal::instance()
 {
@@ -53,10 +82,6 @@ void ZGlobal::initialize()
 #endif
     setlocale (LC_NUMERIC, "C");
 
-#ifdef WITH_OCR
-    initializeOCR();
-#endif
-
     qRegisterMetaType<ZKanjiRadicalItem>("ZKanjiRadicalItem");
 #if QT_VERSION >= QT_VERSION_CHECK(6,0,0)
     qRegisterMetaType<ZKanjiInfo>("ZKanjiInfo");
@@ -68,11 +93,63 @@ void ZGlobal::initialize()
     qRegisterMetaTypeStreamOperators<ZKanjiInfoHash>("ZKanjiInfoHash");
 #endif
 
-    QGuiApplication::setApplicationDisplayName(QSL("QJRad - Kanji Lookup Tool"));
+    if (!isHeadless())
+        QGuiApplication::setApplicationDisplayName(QSL("QJRad - Kanji Lookup Tool"));
     QCoreApplication::setOrganizationName(QSL("kernel1024"));
     QCoreApplication::setApplicationName(QSL("qjrad"));
 
     QCoreApplication::setAttribute(Qt::AA_DontUseNativeDialogs,true);
+
+    // OCR settings and cache location depend on application name
+#ifdef WITH_OCR
+    if (!isHeadless())
+        initializeOCR();
+#endif
+
+    updateArticleCacheSettings();
+}
+
+bool ZGlobal::isHeadless()
+{
+    return (qobject_cast<QApplication *>(QCoreApplication::instance()) == nullptr);
+}
+
+bool ZGlobal::startDaemon()
+{
+    if (!m_dbusRegistered)
+        qWarning() << "Unable to register org.qjrad.dictionary on the session bus, D-Bus interface disabled";
+
+    // word dictionaries are parsed by controller in background, overlap them with kanji data loading
+    connect(dictManager,&ZDict::ZDictController::dictionariesLoaded,this,[](const QString& message){
+        qInfo() << message;
+    },Qt::QueuedConnection);
+    loadDictionaries();
+
+    auto *dict = new ZKanjiDictionary(this);
+    if (!dict->loadDictionaries(nullptr,false)) {
+        qCritical() << "Cannot load kanji dictionaries:" << dict->getErrorString();
+        dict->deleteLater();
+        return false;
+    }
+    kanjiDictionary = dict;
+
+    qInfo() << "QJRad dictionary daemon started";
+    return true;
+}
+
+void ZGlobal::startLocalServer()
+{
+    QSettings stg;
+    stg.beginGroup(QSL("Server"));
+    const bool enabled = stg.value(QSL("localSocket"),CDefaults::localSocketEnabled).toBool();
+    const QString name = stg.value(QSL("localSocketName"),QString::fromLatin1(CDefaults::localSocketName)).toString();
+    stg.endGroup();
+
+    if (!enabled || name.isEmpty())
+        return;
+
+    if (localServer->listen(name))
+        qInfo() << "Local query server is listening on" << localServer->serverName();
 }
 
 void ZGlobal::deferredQuit()
@@ -136,9 +213,92 @@ QFont ZGlobal::fontLabels() const
 
 void ZGlobal::loadDictionaries()
 {
+    // articles rendered with previous dictionary set must not be served anymore
+    invalidateDictionaryResults();
+    updateArticleCacheSettings();
+
     dictManager->loadDictionaries(getDictPaths());
 }
 
+void ZGlobal::invalidateDictionaryResults()
+{
+    m_dictGeneration.fetchAndAddOrdered(1);
+    articleCache->clear();
+}
+
+quint32 ZGlobal::dictGeneration() const
+{
+    return m_dictGeneration.loadAcquire();
+}
+
+quint32 ZGlobal::dictInterrupts() const
+{
+    return m_dictInterrupts.loadAcquire();
+}
+
+QString ZGlobal::loadArticle(const QString &word, const QObject *requester, bool foreground)
+{
+    const quint32 generation = dictGeneration();
+
+    QString res;
+    if (articleCache->lookup(word,generation,res))
+        return res;
+
+    // concurrent requests for the same word share one controller call
+    return articleFlights->load(word,generation,requester,[this,generation,foreground](const QString &w){
+        QString article;
+        if (articleCache->lookup(w,generation,article))
+            return article;
+
+        if (foreground && articlePrefetcher)
+            articlePrefetcher->beginForeground();
+
+        for (int attempt = 0; ; attempt++) {
+            const quint32 interrupts = m_wordSearchInterrupts.loadAcquire();
+            article = dictManager->loadArticle(w);
+            // controller cancellation for GUI word search is global, other requesters still wait for this article
+            if (m_wordSearchInterrupts.loadAcquire() == interrupts || attempt >= CDefaults::articleInterruptRetries)
+                break;
+        }
+
+        if (foreground && articlePrefetcher)
+            articlePrefetcher->endForeground();
+
+        if (!article.isEmpty())
+            articleCache->insert(w,generation,article);
+
+        return article;
+    });
+}
+
+void ZGlobal::cancelDictionaryWork(const QObject *requester, bool wordSearch)
+{
+    // controller cancellation is global, use it only when nobody else waits for articles,
+    // or when stale word search must stop anyway - interrupted article loads are restarted
+    if (!articleFlights->cancel(requester)) {
+        m_dictInterrupts.fetchAndAddOrdered(1);
+        dictManager->cancelActiveWork();
+    } else if (wordSearch) {
+        m_wordSearchInterrupts.fetchAndAddOrdered(1);
+        m_dictInterrupts.fetchAndAddOrdered(1);
+        dictManager->cancelActiveWork();
+    }
+}
+
+void ZGlobal::updateArticleCacheSettings()
+{
+    const qint64 megabyte = 1024 * 1024;
+
+    QSettings stg;
+    stg.beginGroup(QSL("Main"));
+    const int sizeMB = stg.value(QSL("articleCacheSize"),CDefaults::articleCacheSizeMB).toInt();
+    const bool compression = stg.value(QSL("articleCacheCompression"),CDefaults::articleCacheCompression).toBool();
+    stg.endGroup();
+
+    articleCache->setMaxBytes(qMax(0,sizeMB) * megabyte);
+    articleCache->setCompression(compression);
+}
+
 QColor ZGlobal::middleColor(const QColor &c1, const QColor &c2, int mul, int div)
 {
     QColor res(c1.red()+mul*(c2.red()-c1.red())/div,
@@ -168,10 +328,10 @@ qint64 ZGlobal::writeData(QFile* file, const QVariant &data)
     return (file->pos() - pos);
 }
 
-QVariant ZGlobal::readData(QFile* file, const QVariant &defaultValue)
+QVariant ZGlobal::readData(QIODevice* device, const QVariant &defaultValue)
 {
     QVariant res;
-    QDataStream bigdata(file);
+    QDataStream bigdata(device);
     bigdata.setVersion(QDataStream::Qt_5_10);
     bigdata >> res;
 
@@ -188,18 +348,9 @@ QVariant ZGlobal::readData(QFile* file, const QVariant &defaultValue)
 
 #ifdef WITH_OCR
 
-QString ZGlobal::processImageWithOCR(const QImage &image)
-{
-    m_ocr->SetImage(Image2PIX(image));
-    char* rtext = m_ocr->GetUTF8Text();
-    QString s = QString::fromUtf8(rtext);
-    delete[] rtext;
-    return s;
-}
-
 bool ZGlobal::isOCRReady() const
 {
-    return (m_ocr!=nullptr);
+    return ((ocrService != nullptr) && ocrService->isReady());
 }
 
 QString ZGlobal::ocrGetActiveLanguage()
@@ -221,38 +372,37 @@ QString ZGlobal::ocrGetDatapath()
     return res;
 }
 
-PIX* ZGlobal::Image2PIX(const QImage &qImage) {
-    PIX * pixs = nullptr;
-    l_uint32 *lines = nullptr;
-
-    QImage img = qImage.rgbSwapped();
-    int width = img.width();
-    int height = img.height();
-    int depth = img.depth();
-    int wpl = img.bytesPerLine() / 4;
-
-    pixs = pixCreate(width, height, depth);
-    pixSetWpl(pixs, wpl);
-    pixSetColormap(pixs, nullptr);
-    l_uint32 *datas = pixGetData(pixs);
-
-    for (int y = 0; y < height; y++) {
-        lines = datas + y * wpl;
-        memcpy(lines,img.scanLine(y),static_cast<uint>(img.bytesPerLine()));
-    }
-    return pixEndianByteSwapNew(pixs);
+int ZGlobal::ocrGetEngines()
+{
+    QSettings settings;
+    settings.beginGroup(QSL("OCR"));
+    int res = settings.value(QSL("engines"),CDefaults::ocrEngines).toInt();
+    settings.endGroup();
+    return qBound(1,res,QThread::idealThreadCount());
 }
 
 void ZGlobal::initializeOCR()
 {
-    m_ocr = new tesseract::TessBaseAPI();
-    QByteArray tesspath = ocrGetDatapath().toUtf8();
+    // engines are initialized in their worker threads, GUI startup is not delayed
+    const QDir dataPath(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    if (!dataPath.exists())
+        dataPath.mkpath(QSL("."));
 
-    QString lang = ocrGetActiveLanguage();
-    if (lang.isEmpty() || (m_ocr->Init(tesspath.constData(),lang.toUtf8().constData())!=0)) {
-        qCritical() << "Could not initialize Tesseract. "
-                       "Maybe language training data is not installed.";
-    }
+    QSettings settings;
+    settings.beginGroup(QSL("OCR"));
+    const int cacheSizeKB = settings.value(QSL("cacheSize"),CDefaults::ocrCacheSizeKB).toInt();
+    settings.endGroup();
+
+    const qint64 kilobyte = 1024;
+    // size bound must be known before persisted entries are read
+    ocrCache = new ZOCRCache(this);
+    ocrCache->setMaxBytes(qMax(0,cacheSizeKB) * kilobyte);
+    ocrCache->load(dataPath.filePath(QSL("ocrcache")));
+
+    ocrService = new ZOCRService(this);
+    ocrService->setPreprocessOptions(ZOCRPreprocessor::Options::fromSettings());
+    ocrService->setResultCache(ocrCache);
+    ocrService->start(ocrGetEngines(),ocrGetDatapath(),ocrGetActiveLanguage());
 }
 
 #endif
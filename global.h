@@ -8,8 +8,15 @@
 #include <QFont>
 #include <QPoint>
 #include <QSize>
+#include <QPointer>
 
 #include "zdict/zdictcontroller.h"
+#include "articlecache.h"
+#include "articleprefetcher.h"
+#include "articleflights.h"
+#include "dictworkerpool.h"
+#include "localserver.h"
+#include "kdictionary.h"
 
 #ifdef WITH_OCR
 #include <tesseract/baseapi.h>
@@ -18,6 +25,8 @@
 #if TESSERACT_MAJOR_VERSION>=4
     #define JTESS_API4 1
 #endif
+
+#include "ocrservice.h"
 #endif
 
 #define zF (ZGlobal::instance())
@@ -30,6 +39,13 @@ const int maxHButtons = 30;
 const int maxKanaHButtons = 15;
 const int maxDictionaryResults = 10000;
 const int dictSplitterPos = 200;
+const int articleCacheSizeMB = 16;
+const bool articleCacheCompression = true;
+const int prefetchArticles = 5;
+const int prefetchNeighbors = 2;
+const int dictWorkerQueueLimit = 256;
+const int ocrEngines = 1;
+const int ocrCacheSizeKB = 1024;
 }
 
 class ZGlobal : public QObject
@@ -38,6 +54,12 @@ class ZGlobal : public QObject
 public:
     QPointer<ZDict::ZDictController> dictManager;
     ZKanjiDBusDict* dbusDict { nullptr };
+    ZArticleCache* articleCache { nullptr };
+    ZArticlePrefetcher* articlePrefetcher { nullptr };
+    ZArticleFlights* articleFlights { nullptr };
+    ZDictWorkerPool* dictWorkers { nullptr };
+    ZLocalQueryServer* localServer { nullptr };
+    QPointer<ZKanjiDictionary> kanjiDictionary;
 
     QFont fontResults() const;
     QFont fontBtn() const;
@@ -47,27 +69,43 @@ public:
     ~ZGlobal() override;
     static ZGlobal* instance();
     void initialize();
+    bool startDaemon();
+    void startLocalServer();
+    static bool isHeadless();
     void deferredQuit();
 
     QStringList getDictPaths();
     void loadDictionaries();
+    quint32 dictGeneration() const;
+    quint32 dictInterrupts() const;
+    QString loadArticle(const QString &word, const QObject *requester = nullptr, bool foreground = true);
+    void cancelDictionaryWork(const QObject *requester, bool wordSearch = false);
     static QColor middleColor(const QColor &c1, const QColor &c2, int mul = 50, int div = 100);
     static QString makeSimpleHtml(const QString &title, const QString &content);
 
     static qint64 writeData(QFile* file, const QVariant &data);
-    static QVariant readData(QFile* file, const QVariant &defaultValue = QVariant());
+    static QVariant readData(QIODevice* device, const QVariant &defaultValue = QVariant());
+
+private:
+    QAtomicInteger<quint32> m_dictGeneration { 0 };
+    QAtomicInteger<quint32> m_wordSearchInterrupts { 0 };
+    QAtomicInteger<quint32> m_dictInterrupts { 0 };
+    bool m_dbusRegistered { false };
+
+    void updateArticleCacheSettings();
+    void invalidateDictionaryResults();
 
+public:
 #ifdef WITH_OCR
+    ZOCRService* ocrService { nullptr };
+    ZOCRCache* ocrCache { nullptr };
+
     QString ocrGetActiveLanguage();
     QString ocrGetDatapath();
+    int ocrGetEngines();
     void initializeOCR();
-    QString processImageWithOCR(const QImage& image);
     bool isOCRReady() const;
 
-private:
-    tesseract::TessBaseAPI* m_ocr { nullptr };
-    static PIX* Image2PIX(const QImage& qImage);
-
 #endif
 };
 
@@ -0,0 +1,244 @@
+#include "imagekernels.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace CDefaults {
+const int grayWeightR = 77;
+const int grayWeightG = 150;
+const int grayWeightB = 29;
+const int grayShift = 8;
+const int grayRound = 128;
+const quint32 byteMask = 0xff;
+}
+
+namespace {
+
+inline quint8 rgbToGray(quint32 px)
+{
+    const quint32 r = (px >> 16) & CDefaults::byteMask; // NOLINT
+    const quint32 g = (px >> 8) & CDefaults::byteMask; // NOLINT
+    const quint32 b = px & CDefaults::byteMask;
+    return static_cast<quint8>((r * CDefaults::grayWeightR + g * CDefaults::grayWeightG +
+                                b * CDefaults::grayWeightB + CDefaults::grayRound) >> CDefaults::grayShift);
+}
+
+#ifdef __SSE2__
+inline __m128i rgbToGray4(__m128i px)
+{
+    // 16-bit lanes: [B,R] and [G,A] per pixel, madd sums weighted pairs into 32-bit lanes
+    const __m128i mask = _mm_set1_epi32(0x00ff00ff);
+    const __m128i wBR = _mm_set1_epi32((CDefaults::grayWeightR << 16) | CDefaults::grayWeightB); // NOLINT
+    const __m128i wG = _mm_set1_epi32(CDefaults::grayWeightG);
+    const __m128i rnd = _mm_set1_epi32(CDefaults::grayRound);
+
+    const __m128i br = _mm_and_si128(px,mask);
+    const __m128i ga = _mm_and_si128(_mm_srli_epi32(px,8),mask); // NOLINT
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(br,wBR),_mm_madd_epi16(ga,wG));
+    sum = _mm_add_epi32(sum,rnd);
+    return _mm_srli_epi32(sum,CDefaults::grayShift);
+}
+
+inline __m128i byteSwap32(__m128i v)
+{
+    // swap bytes inside 16-bit lanes, then swap 16-bit halves of each 32-bit lane
+    v = _mm_or_si128(_mm_slli_epi16(v,8),_mm_srli_epi16(v,8)); // NOLINT
+    v = _mm_shufflelo_epi16(v,_MM_SHUFFLE(2,3,0,1)); // NOLINT
+    return _mm_shufflehi_epi16(v,_MM_SHUFFLE(2,3,0,1)); // NOLINT
+}
+#endif
+
+}
+
+void ZImageKernels::rgb32ToGray(const quint32 *src, quint8 *dst, int count)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const int block = 16;
+    for (; i + block <= count; i += block) {
+        const auto *s = reinterpret_cast<const __m128i *>(src + i); // NOLINT
+        const __m128i g0 = rgbToGray4(_mm_loadu_si128(s));
+        const __m128i g1 = rgbToGray4(_mm_loadu_si128(s + 1)); // NOLINT
+        const __m128i g2 = rgbToGray4(_mm_loadu_si128(s + 2)); // NOLINT
+        const __m128i g3 = rgbToGray4(_mm_loadu_si128(s + 3)); // NOLINT
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(g0,g1),_mm_packs_epi32(g2,g3));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),packed); // NOLINT
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = rgbToGray(src[i]); // NOLINT
+}
+
+void ZImageKernels::rgb30ToRgb32(const quint32 *src, quint32 *dst, int count)
+{
+    // keep 8 most significant bits of each 10-bit channel
+    const quint32 alpha = 0xff000000;
+    const quint32 maskR = 0x00ff0000;
+    const quint32 maskG = 0x0000ff00;
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i vAlpha = _mm_set1_epi32(static_cast<int>(alpha));
+    const __m128i vMaskR = _mm_set1_epi32(maskR);
+    const __m128i vMaskG = _mm_set1_epi32(maskG);
+    const __m128i vMaskB = _mm_set1_epi32(CDefaults::byteMask);
+    const int block = 4;
+    for (; i + block <= count; i += block) {
+        const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)); // NOLINT
+        const __m128i r = _mm_and_si128(_mm_srli_epi32(px,6),vMaskR); // NOLINT
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(px,4),vMaskG); // NOLINT
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(px,2),vMaskB); // NOLINT
+        const __m128i res = _mm_or_si128(_mm_or_si128(r,g),_mm_or_si128(b,vAlpha));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),res); // NOLINT
+    }
+#endif
+    for (; i < count; i++) {
+        const quint32 px = src[i]; // NOLINT
+        dst[i] = alpha | ((px >> 6) & maskR) | ((px >> 4) & maskG) | ((px >> 2) & CDefaults::byteMask); // NOLINT
+    }
+}
+
+void ZImageKernels::grayToPixWords(const quint8 *src, quint32 *dst, int count)
+{
+    const int words = count / 4;
+    int w = 0;
+#ifdef __SSE2__
+    const int block = 4;
+    for (; w + block <= words; w += block) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + w * 4)); // NOLINT
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + w),byteSwap32(v)); // NOLINT
+    }
+#endif
+    for (; w < words; w++) {
+        const quint8 *s = src + w * 4; // NOLINT
+        dst[w] = (static_cast<quint32>(s[0]) << 24) | (static_cast<quint32>(s[1]) << 16) | // NOLINT
+                 (static_cast<quint32>(s[2]) << 8) | static_cast<quint32>(s[3]); // NOLINT
+    }
+
+    // partial last word, unused pixels are zero
+    const int rest = count - words * 4;
+    if (rest > 0) {
+        quint32 last = 0;
+        for (int i = 0; i < rest; i++)
+            last |= static_cast<quint32>(src[words * 4 + i]) << (24 - 8 * i); // NOLINT
+        dst[words] = last; // NOLINT
+    }
+}
+
+void ZImageKernels::histogram(const quint8 *src, int count, quint32 *hist)
+{
+    for (int i = 0; i < 256; i++) // NOLINT
+        hist[i] = 0; // NOLINT
+    for (int i = 0; i < count; i++)
+        hist[src[i]]++; // NOLINT
+}
+
+void ZImageKernels::stretchContrast(const quint8 *src, quint8 *dst, int count, quint8 lo, quint8 hi)
+{
+    if (hi <= lo) {
+        for (int i = 0; i < count; i++)
+            dst[i] = src[i]; // NOLINT
+        return;
+    }
+
+    // out = (((v - lo) << 8) * mul) >> 16, mul fits in 16 bits for any non-empty range
+    const quint32 mul = (255U << 8U) / static_cast<quint32>(hi - lo); // NOLINT
+
+    int i = 0;
+#ifdef __SSE2__
+    const int block = 16;
+    const __m128i vlo = _mm_set1_epi8(static_cast<char>(lo));
+    const __m128i vhi = _mm_set1_epi8(static_cast<char>(hi));
+    const __m128i vmul = _mm_set1_epi16(static_cast<short>(mul));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + block <= count; i += block) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)); // NOLINT
+        v = _mm_subs_epu8(_mm_min_epu8(_mm_max_epu8(v,vlo),vhi),vlo);
+        const __m128i l = _mm_mulhi_epu16(_mm_slli_epi16(_mm_unpacklo_epi8(v,zero),8),vmul); // NOLINT
+        const __m128i h = _mm_mulhi_epu16(_mm_slli_epi16(_mm_unpackhi_epi8(v,zero),8),vmul); // NOLINT
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),_mm_packus_epi16(l,h)); // NOLINT
+    }
+#endif
+    for (; i < count; i++) {
+        const quint32 v = qBound<quint32>(lo,src[i],hi) - lo; // NOLINT
+        dst[i] = static_cast<quint8>(((v << 8U) * mul) >> 16U); // NOLINT
+    }
+}
+
+void ZImageKernels::invert(quint8 *data, int count)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const int block = 16;
+    const __m128i ones = _mm_set1_epi8(static_cast<char>(0xff)); // NOLINT
+    for (; i + block <= count; i += block) {
+        auto *p = reinterpret_cast<__m128i *>(data + i); // NOLINT
+        _mm_storeu_si128(p,_mm_xor_si128(_mm_loadu_si128(p),ones));
+    }
+#endif
+    for (; i < count; i++)
+        data[i] = static_cast<quint8>(~data[i]); // NOLINT
+}
+
+void ZImageKernels::thresholdRow(const quint8 *src, const quint8 *threshold, quint8 *dst, int count)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const int block = 16;
+    for (; i + block <= count; i += block) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)); // NOLINT
+        const __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(threshold + i)); // NOLINT
+        // v >= t  <=>  max(v,t) == v
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),_mm_cmpeq_epi8(_mm_max_epu8(v,t),v)); // NOLINT
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = (src[i] < threshold[i]) ? 0 : 0xff; // NOLINT
+}
+
+int ZImageKernels::countChanged(const quint8 *a, const quint8 *b, int count, quint8 tolerance)
+{
+    int res = 0;
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i vTol = _mm_set1_epi8(static_cast<char>(tolerance));
+    const __m128i zero = _mm_setzero_si128();
+    const int block = 16;
+    for (; i + block <= count; i += block) {
+        const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)); // NOLINT
+        const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)); // NOLINT
+        // |a-b| with unsigned saturation, then lanes above tolerance stay non-zero
+        const __m128i diff = _mm_or_si128(_mm_subs_epu8(va,vb),_mm_subs_epu8(vb,va));
+        const __m128i over = _mm_cmpeq_epi8(_mm_subs_epu8(diff,vTol),zero);
+        const auto unchanged = static_cast<quint32>(_mm_movemask_epi8(over));
+        for (quint32 bits = ~unchanged & 0xffffU; bits != 0; bits &= bits - 1) // NOLINT
+            res++;
+    }
+#endif
+    for (; i < count; i++) {
+        const int diff = static_cast<int>(a[i]) - static_cast<int>(b[i]); // NOLINT
+        if (qAbs(diff) > tolerance)
+            res++;
+    }
+    return res;
+}
+
+void ZImageKernels::upscaleRow(const quint8 *src, quint8 *dst, int count, int factor)
+{
+    int i = 0;
+#ifdef __SSE2__
+    if (factor == 2) {
+        const int block = 16;
+        for (; i + block <= count; i += block) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)); // NOLINT
+            auto *d = reinterpret_cast<__m128i *>(dst + i * 2); // NOLINT
+            _mm_storeu_si128(d,_mm_unpacklo_epi8(v,v));
+            _mm_storeu_si128(d + 1,_mm_unpackhi_epi8(v,v)); // NOLINT
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        for (int k = 0; k < factor; k++)
+            dst[i * factor + k] = src[i]; // NOLINT
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef IMAGEKERNELS_H
+#define IMAGEKERNELS_H
+
+#include <QtGlobal>
+
+namespace ZImageKernels {
+
+// 0xAARRGGBB pixels to 8-bit luma (BT.601 integer weights)
+void rgb32ToGray(const quint32 *src, quint8 *dst, int count);
+
+// X11 depth 30 pixels (2:10:10:10) to opaque 0xffRRGGBB, dst may be equal to src
+void rgb30ToRgb32(const quint32 *src, quint32 *dst, int count);
+
+// 8-bit pixels to leptonica 8 bpp raster words (first pixel in MSB)
+void grayToPixWords(const quint8 *src, quint32 *dst, int count);
+
+void histogram(const quint8 *src, int count, quint32 *hist);
+
+// linear stretch of [lo..hi] range to [0..255], values outside are clamped
+void stretchContrast(const quint8 *src, quint8 *dst, int count, quint8 lo, quint8 hi);
+
+void invert(quint8 *data, int count);
+
+// dst = (src < threshold) ? 0 : 255, per-pixel thresholds
+void thresholdRow(const quint8 *src, const quint8 *threshold, quint8 *dst, int count);
+
+// number of pixels which differ by more than tolerance
+int countChanged(const quint8 *a, const quint8 *b, int count, quint8 tolerance);
+
+// horizontal pixel replication, dst must hold count * factor pixels
+void upscaleRow(const quint8 *src, quint8 *dst, int count, int factor);
+
+}
+
+#endif // IMAGEKERNELS_H
@@ -1,11 +1,16 @@
 #include <QProgressDialog>
 #include <QDomDocument>
 #include <QFile>
+#include <QBuffer>
+#include <QSaveFile>
+#include <QFileInfo>
 #include <QTextStream>
 #include <QApplication>
 #include <QStandardPaths>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QElapsedTimer>
+#include <QtConcurrent>
 #include <QDebug>
 #include <algorithm>
 #include <set>
@@ -22,6 +27,22 @@ const QString radkFileName          (QSL("radkfilex.utf8"));
 const QString kradFileName          (QSL("kradfilex.utf8"));
 const QString xmlKanjiDictFileName  (QSL("kanjidic2.xml"));
 const QString versionFileName       (QSL("version"));
+const QString offsetsFileName       (QSL("offsets"));
+
+namespace CDefaults {
+const quint32 kanjiOffsetsMagic = 0x514a4b4f;
+const quint32 kanjiOffsetsVersion = 1;
+}
+
+class ZKanjiOffsetsHeader {
+public:
+    quint32 magic { 0 };
+    quint32 version { 0 };
+    qint64 count { 0 };
+};
+
+static_assert(sizeof(ZKanjiOffsetsHeader) == 16 && sizeof(ZKanjiOffset) == 16,
+              "kanji offsets cache layout is mapped directly");
 
 ZKanjiDictionary::ZKanjiDictionary(QObject *parent) :
     QObject(parent)
@@ -31,26 +52,94 @@ ZKanjiDictionary::ZKanjiDictionary(QObject *parent) :
         m_dataPath.mkpath(QSL("."));
 }
 
-bool ZKanjiDictionary::loadDictionaries(QWidget *mainWindow)
+ZKanjiDictionary::~ZKanjiDictionary()
 {
+    unmapDictionaryFiles();
+}
+
+bool ZKanjiDictionary::loadDictionaries(QWidget *mainWindow, bool interactive)
+{
+    // worker pool queries wait until the whole data set is replaced
+    QWriteLocker locker(&m_lock);
+
+    unmapDictionaryFiles();
     m_radicalsList.clear();
     m_radicalsLookup.clear();
+    m_kanjiParts.clear();
     m_kanjiStrokes.clear();
     m_kanjiGrade.clear();
     m_errorString.clear();
 
     if (!isDictionaryDataValid()) {
+        if (!interactive) {
+            m_errorString = tr("Kanji dictionary data is not prepared in %1, "
+                               "start qjrad in GUI mode once to build it.").arg(m_dataPath.path());
+            return false;
+        }
         if (!setupDictionaryData(mainWindow))
             return false;
     }
 
-    // Load radicals dictionary
-    QFile fr(m_dataPath.filePath(radkFileName));
-    if (!fr.open(QIODevice::ReadOnly)) {
-        m_errorString = tr("cannot read kanji lookup table");
-        return false;
+    // data files are independent, parse them concurrently and report per-file load time
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<LoadTask> tasks;
+    tasks.append(LoadTask(radkFileName,tr("cannot read kanji lookup table"),[this](QFile* file){
+        loadRadicalsTable(file);
+    }));
+    tasks.append(LoadTask(kradFileName,tr("cannot read kanji radicals list"),[this](QFile* file){
+        loadKanjiParts(file);
+    }));
+    tasks.append(LoadTask(strokesFileName,tr("Unable to load strokes info from dictionary"),[this](QFile* file){
+        m_kanjiStrokes = ZGlobal::readData(file).value<ZKanjiInfoHash>();
+    }));
+    tasks.append(LoadTask(gradeFileName,tr("Unable to load grade info from dictionary"),[this](QFile* file){
+        m_kanjiGrade = ZGlobal::readData(file).value<ZKanjiInfoHash>();
+    }));
+    tasks.append(LoadTask(indexFileName,tr("Unable to load kanji index info from dictionary"),[this](QFile* file){
+        // hash is used only on disk, lookups go through sorted compact offsets table cached next to it
+        if (!mapOffsetsCache())
+            buildOffsetsCache(file);
+    }));
+
+    QVector<QFuture<void> > futures;
+    futures.reserve(tasks.count());
+    for (auto &task : tasks) {
+        futures.append(QtConcurrent::run([this,&task](){
+            QElapsedTimer taskTimer;
+            taskTimer.start();
+            QFile file(m_dataPath.filePath(task.fileName));
+            task.opened = file.open(QIODevice::ReadOnly);
+            if (task.opened)
+                task.loader(&file);
+            task.elapsedMS = taskTimer.elapsed();
+        }));
     }
-    QTextStream sr(&fr);
+    for (auto &future : futures)
+        future.waitForFinished();
+
+    QStringList timings;
+    timings.reserve(tasks.count());
+    for (const auto &task : std::as_const(tasks)) {
+        if (!task.opened) {
+            m_errorString = task.errorString;
+            return false;
+        }
+        timings.append(QSL("%1 %2 ms").arg(task.fileName).arg(task.elapsedMS));
+    }
+    mapDictionaryFile();
+
+    qInfo().noquote() << QSL("Kanji dictionary loaded in %1 ms (%2)")
+                         .arg(timer.elapsed())
+                         .arg(timings.join(QSL(", ")));
+
+    return true;
+}
+
+void ZKanjiDictionary::loadRadicalsTable(QFile *file)
+{
+    QTextStream sr(file);
     QChar krad;
     int kst = 0;
     while (!sr.atEnd()) {
@@ -71,15 +160,11 @@ bool ZKanjiDictionary::loadDictionaries(QWidget *mainWindow)
             }
         }
     }
-    fr.close();
+}
 
-    // Load radicals list
-    QFile fp(m_dataPath.filePath(kradFileName));
-    if (!fp.open(QIODevice::ReadOnly)) {
-        m_errorString = tr("cannot read kanji radicals list");
-        return false;
-    }
-    QTextStream sp(&fp);
+void ZKanjiDictionary::loadKanjiParts(QFile *file)
+{
+    QTextStream sp(file);
     while (!sp.atEnd()) {
         const QString s = sp.readLine().trimmed();
         if (s.startsWith('#')) continue; // comment
@@ -90,33 +175,6 @@ bool ZKanjiDictionary::loadDictionaries(QWidget *mainWindow)
             m_kanjiParts[k] = sl.join(QString());
         }
     }
-    fp.close();
-
-    QFile fstrokes(m_dataPath.filePath(strokesFileName));
-    if (!fstrokes.open(QIODevice::ReadOnly)) {
-        m_errorString = tr("Unable to load strokes info from dictionary");
-        return false;
-    }
-    m_kanjiStrokes = ZGlobal::readData(&fstrokes).value<ZKanjiInfoHash>();
-    fstrokes.close();
-
-    QFile fgrade(m_dataPath.filePath(gradeFileName));
-    if (!fgrade.open(QIODevice::ReadOnly)) {
-        m_errorString = tr("Unable to load grade info from dictionary");
-        return false;
-    }
-    m_kanjiGrade = ZGlobal::readData(&fgrade).value<ZKanjiInfoHash>();
-    fgrade.close();
-
-    QFile findex(m_dataPath.filePath(indexFileName));
-    if (!findex.open(QIODevice::ReadOnly)) {
-        m_errorString = tr("Unable to load kanji index info from dictionary");
-        return false;
-    }
-    m_kanjiIndex = ZGlobal::readData(&findex).value<ZKanjiIndex>();
-    findex.close();
-
-    return true;
 }
 
 bool ZKanjiDictionary::setupDictionaryData(QWidget* mainWindow)
@@ -153,6 +211,10 @@ bool ZKanjiDictionary::setupDictionaryData(QWidget* mainWindow)
 
 void ZKanjiDictionary::deleteDictionaryData()
 {
+    QWriteLocker locker(&m_lock);
+
+    unmapDictionaryFiles();
+
     QFile f1(m_dataPath.filePath(kanjiDictFileName));
     QFile f2(m_dataPath.filePath(indexFileName));
     QFile f3(m_dataPath.filePath(strokesFileName));
@@ -160,6 +222,7 @@ void ZKanjiDictionary::deleteDictionaryData()
     QFile f5(m_dataPath.filePath(radkFileName));
     QFile f6(m_dataPath.filePath(kradFileName));
     QFile f7(m_dataPath.filePath(versionFileName));
+    QFile f8(m_dataPath.filePath(offsetsFileName));
 
     f1.remove();
     f2.remove();
@@ -168,6 +231,7 @@ void ZKanjiDictionary::deleteDictionaryData()
     f5.remove();
     f6.remove();
     f7.remove();
+    f8.remove();
 }
 
 bool ZKanjiDictionary::isDictionaryDataValid()
@@ -196,6 +260,7 @@ bool ZKanjiDictionary::isDictionaryDataValid()
 
 QString ZKanjiDictionary::sortKanji(const QString &src)
 {
+    QReadLocker locker(&m_lock);
     QString s = src;
     std::sort(s.begin(),s.end(),[this](const QChar &c1, const QChar &c2) {
         if (!m_kanjiStrokes.contains(c1) || !m_kanjiStrokes.contains(c2)) // also here
@@ -215,11 +280,24 @@ QString ZKanjiDictionary::sortKanji(const QString &src)
 
 ZKanjiInfo ZKanjiDictionary::getKanjiInfo(QChar kanji)
 {
-    auto idx = m_kanjiIndex.value(kanji.unicode(),-1L);
+    QReadLocker locker(&m_lock);
+    const qint64 idx = kanjiOffset(kanji);
 
     if (idx < 0L)
         return ZKanjiInfo();
 
+    // read lock also keeps mapping alive, reload unmaps files only under write lock
+    if (m_dictData && idx < m_dictSize) {
+        // only pages of requested records become resident, mapping is shared by all lookup threads
+        const QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(m_dictData) + idx,
+                                                        static_cast<int>(m_dictSize - idx));
+        QBuffer buffer;
+        buffer.setData(data);
+        if (!buffer.open(QIODevice::ReadOnly))
+            return ZKanjiInfo();
+        return ZGlobal::readData(&buffer,QVariant::fromValue(ZKanjiInfo())).value<ZKanjiInfo>();
+    }
+
     QFile fdict(m_dataPath.filePath(kanjiDictFileName));
     if (!fdict.open(QIODevice::ReadOnly))
         return ZKanjiInfo();
@@ -230,6 +308,126 @@ ZKanjiInfo ZKanjiDictionary::getKanjiInfo(QChar kanji)
     return ki;
 }
 
+qint64 ZKanjiDictionary::kanjiOffset(QChar kanji) const
+{
+    if (m_offsets == nullptr)
+        return -1L;
+
+    const quint32 code = kanji.unicode();
+    const ZKanjiOffset* end = m_offsets + m_offsetsCount;
+    const ZKanjiOffset* it = std::lower_bound(m_offsets,end,code,[](const ZKanjiOffset &item, quint32 value){
+        return item.code < value;
+    });
+    if (it == end || it->code != code)
+        return -1L;
+
+    return it->offset;
+}
+
+bool ZKanjiDictionary::mapOffsetsCache()
+{
+    const QFileInfo fiIndex(m_dataPath.filePath(indexFileName));
+    const QFileInfo fiOffsets(m_dataPath.filePath(offsetsFileName));
+    if (!fiOffsets.isReadable() || fiOffsets.lastModified() < fiIndex.lastModified())
+        return false;
+
+    m_offsetsFile.setFileName(fiOffsets.filePath());
+    if (!m_offsetsFile.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = m_offsetsFile.size();
+    const auto headerSize = static_cast<qint64>(sizeof(ZKanjiOffsetsHeader));
+    if (size >= headerSize)
+        m_offsetsData = m_offsetsFile.map(0,size);
+    if (m_offsetsData == nullptr) {
+        m_offsetsFile.close();
+        return false;
+    }
+
+    const auto *header = reinterpret_cast<const ZKanjiOffsetsHeader *>(m_offsetsData);
+    if (header->magic != CDefaults::kanjiOffsetsMagic || header->version != CDefaults::kanjiOffsetsVersion ||
+            header->count < 0 || size != headerSize + header->count * static_cast<qint64>(sizeof(ZKanjiOffset))) {
+        qWarning() << "Kanji offsets cache is invalid, rebuilding" << fiOffsets.filePath();
+        m_offsetsFile.unmap(const_cast<uchar *>(m_offsetsData));
+        m_offsetsData = nullptr;
+        m_offsetsFile.close();
+        return false;
+    }
+
+    m_offsets = reinterpret_cast<const ZKanjiOffset *>(m_offsetsData + headerSize);
+    m_offsetsCount = header->count;
+    return true;
+}
+
+void ZKanjiDictionary::buildOffsetsCache(QFile *indexFile)
+{
+    const ZKanjiIndex index = ZGlobal::readData(indexFile).value<ZKanjiIndex>();
+    m_kanjiOffsets.clear();
+    m_kanjiOffsets.reserve(index.count());
+    for (auto it = index.constBegin(), end = index.constEnd(); it != end; ++it) {
+        ZKanjiOffset item;
+        item.code = it.key();
+        item.offset = it.value();
+        m_kanjiOffsets.append(item);
+    }
+    std::sort(m_kanjiOffsets.begin(),m_kanjiOffsets.end(),[](const ZKanjiOffset &a, const ZKanjiOffset &b){
+        return a.code < b.code;
+    });
+    m_offsets = m_kanjiOffsets.constData();
+    m_offsetsCount = m_kanjiOffsets.count();
+
+    // raw table is mapped directly on next start
+    ZKanjiOffsetsHeader header;
+    header.magic = CDefaults::kanjiOffsetsMagic;
+    header.version = CDefaults::kanjiOffsetsVersion;
+    header.count = m_offsetsCount;
+
+    QSaveFile file(m_dataPath.filePath(offsetsFileName));
+    if (!file.open(QIODevice::WriteOnly) ||
+            file.write(reinterpret_cast<const char *>(&header),sizeof(header)) < 0 ||
+            file.write(reinterpret_cast<const char *>(m_kanjiOffsets.constData()),
+                       m_offsetsCount * static_cast<qint64>(sizeof(ZKanjiOffset))) < 0 ||
+            !file.commit()) {
+        qWarning() << "Unable to save kanji offsets cache" << file.fileName();
+    }
+}
+
+void ZKanjiDictionary::mapDictionaryFile()
+{
+    m_dictFile.setFileName(m_dataPath.filePath(kanjiDictFileName));
+    if (!m_dictFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "Unable to open kanji dictionary file" << m_dictFile.fileName();
+        return;
+    }
+
+    m_dictSize = m_dictFile.size();
+    m_dictData = m_dictFile.map(0,m_dictSize);
+    if (m_dictData == nullptr) {
+        // reading through file descriptor per lookup still works
+        qWarning() << "Unable to map kanji dictionary file" << m_dictFile.fileName();
+        m_dictFile.close();
+    }
+}
+
+void ZKanjiDictionary::unmapDictionaryFiles()
+{
+    if (m_dictData)
+        m_dictFile.unmap(const_cast<uchar *>(m_dictData));
+    m_dictData = nullptr;
+    m_dictSize = 0;
+    if (m_dictFile.isOpen())
+        m_dictFile.close();
+
+    if (m_offsetsData)
+        m_offsetsFile.unmap(const_cast<uchar *>(m_offsetsData));
+    m_offsetsData = nullptr;
+    m_offsets = nullptr;
+    m_offsetsCount = 0;
+    m_kanjiOffsets.clear();
+    if (m_offsetsFile.isOpen())
+        m_offsetsFile.close();
+}
+
 QString ZKanjiDictionary::getErrorString() const
 {
     return m_errorString;
@@ -241,13 +439,15 @@ void ZKanjiDictionary::cleanupDictionaries()
     zF->deferredQuit();
 }
 
-const QList<QPair<QChar, int> > &ZKanjiDictionary::getAllRadicals() const
+QList<QPair<QChar, int> > ZKanjiDictionary::getAllRadicals() const
 {
+    QReadLocker locker(&m_lock);
     return m_radicalsList;
 }
 
 ZKanjiRadicalItem ZKanjiDictionary::getRadicalInfo(const QChar &radical) const
 {
+    QReadLocker locker(&m_lock);
     return m_radicalsLookup.value(radical);
 }
 
@@ -256,6 +456,7 @@ QString ZKanjiDictionary::lookupRadicals(const QString &radicals) const
     if (radicals.isEmpty())
         return QString();
 
+    QReadLocker locker(&m_lock);
     QStringList kanjiList;
     kanjiList.reserve(radicals.length());
     for (const auto &rad : radicals)
@@ -290,6 +491,7 @@ QString ZKanjiDictionary::lookupRadicals(const QString &radicals) const
 
 QString ZKanjiDictionary::getKanjiParts(const QChar &kanji) const
 {
+    QReadLocker locker(&m_lock);
     return m_kanjiParts.value(kanji);
 }
 
@@ -462,6 +664,7 @@ bool ZKanjiDictionary::parseKanjiDict(QWidget* mainWindow, const QString &xmlDic
 
 int ZKanjiDictionary::getKanjiGrade(const QChar &kanji) const
 {
+    QReadLocker locker(&m_lock);
     if (m_kanjiGrade.contains(kanji))
         return m_kanjiGrade.value(kanji);
 
@@ -470,6 +673,7 @@ int ZKanjiDictionary::getKanjiGrade(const QChar &kanji) const
 
 int ZKanjiDictionary::getKanjiStrokes(const QChar &kanji) const
 {
+    QReadLocker locker(&m_lock);
     if (m_kanjiStrokes.contains(kanji))
         return m_kanjiStrokes.value(kanji);
 
@@ -518,3 +722,11 @@ ZKanjiRadicalItem::ZKanjiRadicalItem(int aStrokes, const QString &aKanji) :
     kanji(aKanji)
 {
 }
+
+ZKanjiDictionary::LoadTask::LoadTask(const QString &aFileName, const QString &aErrorString,
+                                     const std::function<void (QFile *)> &aLoader) :
+    fileName(aFileName),
+    errorString(aErrorString),
+    loader(aLoader)
+{
+}
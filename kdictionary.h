@@ -6,13 +6,25 @@
 #include <QStringList>
 #include <QHash>
 #include <QList>
+#include <QVector>
+#include <QPair>
 #include <QDataStream>
 #include <QChar>
 #include <QString>
+#include <QFile>
+#include <QReadWriteLock>
+#include <functional>
 
 using ZKanjiIndex = QHash<unsigned int,qint64>;
 using ZKanjiInfoHash = QHash<QChar,int>;
 
+class ZKanjiOffset {
+public:
+    quint32 code { 0 };
+    quint32 reserved { 0 };
+    qint64 offset { 0 };
+};
+
 class ZKanjiRadicalItem {
 public:
     int strokes { 0 };
@@ -55,10 +67,38 @@ private:
     QHash<QChar,QString> m_kanjiParts;
     ZKanjiInfoHash m_kanjiStrokes;
     ZKanjiInfoHash m_kanjiGrade;
-    ZKanjiIndex m_kanjiIndex;
+    QVector<ZKanjiOffset> m_kanjiOffsets;
+    QFile m_offsetsFile;
+    const uchar* m_offsetsData { nullptr };
+    const ZKanjiOffset* m_offsets { nullptr };
+    qint64 m_offsetsCount { 0 };
+    QFile m_dictFile;
+    const uchar* m_dictData { nullptr };
+    qint64 m_dictSize { 0 };
 
     QDir m_dataPath;
     QString m_errorString;
+    mutable QReadWriteLock m_lock { QReadWriteLock::Recursive };
+
+    class LoadTask {
+    public:
+        QString fileName;
+        QString errorString;
+        std::function<void(QFile*)> loader;
+        qint64 elapsedMS { 0 };
+        bool opened { false };
+        LoadTask() = default;
+        LoadTask(const QString &aFileName, const QString &aErrorString,
+                 const std::function<void(QFile*)> &aLoader);
+    };
+
+    void loadRadicalsTable(QFile *file);
+    void loadKanjiParts(QFile *file);
+    bool mapOffsetsCache();
+    void buildOffsetsCache(QFile *indexFile);
+    void mapDictionaryFile();
+    void unmapDictionaryFiles();
+    qint64 kanjiOffset(QChar kanji) const;
 
     bool parseKanjiDict(QWidget *mainWindow, const QString& xmlDictFileName);
     bool setupDictionaryData(QWidget *mainWindow);
@@ -67,15 +107,16 @@ private:
 
 public:
     explicit ZKanjiDictionary(QObject *parent = 0);
+    ~ZKanjiDictionary() override;
 
-    bool loadDictionaries(QWidget *mainWindow);
+    bool loadDictionaries(QWidget *mainWindow, bool interactive = true);
     QString getErrorString() const;
 
     QString sortKanji(const QString &src);
     ZKanjiInfo getKanjiInfo(QChar kanji);
     int getKanjiGrade(const QChar &kanji) const;
     int getKanjiStrokes(const QChar &kanji) const;
-    const QList<QPair<QChar,int> > &getAllRadicals() const;
+    QList<QPair<QChar,int> > getAllRadicals() const;
     ZKanjiRadicalItem getRadicalInfo(const QChar &radical) const;
     QString lookupRadicals(const QString &radicals) const;
     QString getKanjiParts(const QChar &kanji) const;
@@ -0,0 +1,114 @@
+#include <QPointer>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QDebug>
+#include "localserver.h"
+#include "dictquery.h"
+#include "global.h"
+#include "qsl.h"
+
+namespace CDefaults {
+const int localServerMaxLineLength = 1024 * 1024;
+}
+
+ZLocalQueryServer::ZLocalQueryServer(QObject *parent)
+    : QObject(parent)
+{
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server,&QLocalServer::newConnection,this,&ZLocalQueryServer::newConnection);
+}
+
+ZLocalQueryServer::~ZLocalQueryServer() = default;
+
+bool ZLocalQueryServer::listen(const QString &name)
+{
+    close();
+
+    if (!m_server->listen(name)) {
+        // stale socket file from crashed instance
+        QLocalServer::removeServer(name);
+        if (!m_server->listen(name)) {
+            qWarning() << "Unable to start local query server:" << m_server->errorString();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ZLocalQueryServer::close()
+{
+    if (m_server->isListening())
+        m_server->close();
+}
+
+bool ZLocalQueryServer::isListening() const
+{
+    return m_server->isListening();
+}
+
+QString ZLocalQueryServer::serverName() const
+{
+    return m_server->fullServerName();
+}
+
+void ZLocalQueryServer::newConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QLocalSocket* socket = m_server->nextPendingConnection();
+        connect(socket,&QLocalSocket::readyRead,this,&ZLocalQueryServer::readyRead);
+        connect(socket,&QLocalSocket::disconnected,socket,&QLocalSocket::deleteLater);
+    }
+}
+
+void ZLocalQueryServer::readyRead()
+{
+    auto* socket = qobject_cast<QLocalSocket *>(sender());
+    if (socket == nullptr) return;
+
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (!line.isEmpty())
+            processLine(socket,line);
+    }
+
+    if (socket->bytesAvailable() > CDefaults::localServerMaxLineLength) {
+        sendReply(socket,ZDictQuery::errorReply(QJsonObject(),QSL("Request line is too long")));
+        socket->disconnectFromServer();
+    }
+}
+
+void ZLocalQueryServer::processLine(QLocalSocket *socket, const QByteArray &line)
+{
+    QJsonParseError err {};
+    const QJsonDocument doc = QJsonDocument::fromJson(line,&err);
+    if (err.error != QJsonParseError::NoError || !doc.isObject()) {
+        sendReply(socket,ZDictQuery::errorReply(QJsonObject(),QSL("Malformed request: %1")
+                                                .arg(err.errorString())));
+        return;
+    }
+
+    const QJsonObject request = doc.object();
+    QPointer<QLocalSocket> socketPtr(socket);
+    const bool accepted = zF->dictWorkers->tryStart([this,request,socketPtr]{
+        const QJsonObject reply = ZDictQuery::process(request,this);
+        QMetaObject::invokeMethod(this,[socketPtr,reply](){
+            if (socketPtr)
+                sendReply(socketPtr.data(),reply);
+        },Qt::QueuedConnection);
+    });
+
+    if (!accepted)
+        sendReply(socket,ZDictQuery::errorReply(request,QSL("Server is busy, try again later")));
+}
+
+void ZLocalQueryServer::sendReply(QLocalSocket *socket, const QJsonObject &reply)
+{
+    if (socket->state() != QLocalSocket::ConnectedState)
+        return;
+
+    QByteArray data = QJsonDocument(reply).toJson(QJsonDocument::Compact);
+    data.append('\n');
+    socket->write(data);
+}
@@ -0,0 +1,33 @@
+#ifndef LOCALSERVER_H
+#define LOCALSERVER_H
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonObject>
+
+class ZLocalQueryServer : public QObject
+{
+    Q_OBJECT
+private:
+    QLocalServer* m_server { nullptr };
+
+    void processLine(QLocalSocket *socket, const QByteArray &line);
+    static void sendReply(QLocalSocket *socket, const QJsonObject &reply);
+
+public:
+    explicit ZLocalQueryServer(QObject *parent = nullptr);
+    ~ZLocalQueryServer() override;
+
+    bool listen(const QString &name);
+    void close();
+    bool isListening() const;
+    QString serverName() const;
+
+private Q_SLOTS:
+    void newConnection();
+    void readyRead();
+
+};
+
+#endif // LOCALSERVER_H
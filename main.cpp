@@ -1,11 +1,69 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "batchlookup.h"
+#include "batchocr.h"
+#include "ocrbenchmark.h"
 #include "global.h"
 
+static bool hasArgument(int argc, char *argv[], const char *arg)
+{
+    for (int i=1; i<argc; i++) {
+        if (ZBatchLookup::matchesOption(argv[i],arg)) // NOLINT
+            return true;
+    }
+    return false;
+}
+
+static bool hasBatchArgument(int argc, char *argv[])
+{
+    for (int i=1; i<argc; i++) {
+        if (ZBatchLookup::isBatchArgument(argv[i])) // NOLINT
+            return true;
+    }
+    return false;
+}
+
 int main(int argc, char *argv[])
 {
+    // lookup backend only, no GUI resources at all
+    if (hasArgument(argc,argv,"--daemon")) {
+        QCoreApplication a(argc, argv);
+        zF->initialize();
+        if (!zF->startDaemon())
+            return 1;
+        zF->startLocalServer();
+        return a.exec();
+    }
+
+#ifdef WITH_OCR
+    // offline recognition of screenshots and frame dumps
+    if (hasArgument(argc,argv,"--ocr")) {
+        QCoreApplication a(argc, argv);
+        zF->initialize();
+        ZBatchOCR batch;
+        return batch.exec(QCoreApplication::arguments());
+    }
+
+    // font rendering needs GUI application, use -platform offscreen on headless hosts
+    if (hasArgument(argc,argv,"--ocr-benchmark")) {
+        QGuiApplication a(argc, argv);
+        zF->initialize();
+        ZOCRBenchmark benchmark;
+        return benchmark.exec(QCoreApplication::arguments());
+    }
+#endif
+
+    // non-interactive lookups for scripts and benchmarks
+    if (hasBatchArgument(argc,argv)) {
+        QCoreApplication a(argc, argv);
+        zF->initialize();
+        ZBatchLookup batch;
+        return batch.exec(QCoreApplication::arguments());
+    }
+
     QApplication a(argc, argv);
     zF->initialize();
+    zF->startLocalServer();
     ZMainWindow w;
     w.show();
     return a.exec();
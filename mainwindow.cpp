@@ -9,6 +9,10 @@
 #include <QWindow>
 #include <QScreen>
 #include <QSettings>
+#include <QProgressBar>
+#include <QShortcut>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "kanjimodel.h"
@@ -17,6 +21,8 @@
 #include "qsl.h"
 #include "dbusdict.h"
 #include "regiongrabber.h"
+#include "xcbtools.h"
+#include "regionwatcher.h"
 #include "zdict/zdictcontroller.h"
 
 namespace CDefaults {
@@ -57,6 +63,13 @@ ZMainWindow::ZMainWindow(QWidget *parent) :
     statusMsg->setAlignment(Qt::AlignCenter);
     statusBar()->addPermanentWidget(statusMsg);
 
+    ocrProgress = new QProgressBar();
+    ocrProgress->setRange(0,0);
+    ocrProgress->setMaximumWidth(CDefaults::statusBarMessageMinWidth);
+    ocrProgress->setTextVisible(false);
+    ocrProgress->hide();
+    statusBar()->addPermanentWidget(ocrProgress);
+
     connect(ui->btnReset,&QPushButton::clicked,this,&ZMainWindow::resetRadicals);
     connect(ui->btnSettings,&QPushButton::clicked,this,&ZMainWindow::settingsDlg);
     connect(ui->btnOpacity,&QPushButton::clicked,this,&ZMainWindow::opacityList);
@@ -77,11 +90,12 @@ ZMainWindow::ZMainWindow(QWidget *parent) :
     connect(ui->dictWords,&QListWidget::itemSelectionChanged,this,&ZMainWindow::wordListSelectionChanged);
     connect(ui->dictWords,&QListWidget::itemDoubleClicked,this,&ZMainWindow::wordListLookupItem);
 
-    connect(zF->dictManager,&ZDict::ZDictController::wordListComplete,
-            this,&ZMainWindow::updateMatchResults,Qt::QueuedConnection);
-    connect(zF->dictManager,&ZDict::ZDictController::articleComplete,
-            this,&ZMainWindow::articleReady,Qt::QueuedConnection);
-    connect(this,&ZMainWindow::stopDictionaryWork,zF->dictManager,&ZDict::ZDictController::cancelActiveWork);
+    connect(this,&ZMainWindow::stopDictionaryWork,zF->articlePrefetcher,&ZArticlePrefetcher::cancel);
+    connect(this,&ZMainWindow::stopDictionaryWork,this,[this](){
+        // interrupted word search may return partial list, its result is dropped
+        wordSearchSerial++;
+        zF->cancelDictionaryWork(this,wordSearchesInFlight > 0);
+    });
     connect(zF->dictManager,&ZDict::ZDictController::dictionariesLoaded,this,[this](const QString& message){
         statusBar()->showMessage(message,CDefaults::dictManagerStatusMessageTimeout);
     },Qt::QueuedConnection);
@@ -108,9 +122,27 @@ ZMainWindow::ZMainWindow(QWidget *parent) :
 
     zF->loadDictionaries();
 
-#ifndef WITH_OCR
+#ifdef WITH_OCR
+    if (zF->ocrService) {
+        connect(zF->ocrService,&ZOCRService::recognized,this,&ZMainWindow::ocrFinished,Qt::QueuedConnection);
+        connect(zF->ocrService,&ZOCRService::failed,this,&ZMainWindow::ocrFailed,Qt::QueuedConnection);
+        connect(zF->ocrService,&ZOCRService::timings,this,&ZMainWindow::ocrTimings,Qt::QueuedConnection);
+    }
+
+    regionWatcher = new ZRegionWatcher(this);
+    connect(regionWatcher,&ZRegionWatcher::regionChanged,this,&ZMainWindow::regionWatchChanged);
+    connect(ui->btnWatch,&QPushButton::toggled,this,&ZMainWindow::regionWatchToggled);
+
+    auto* recaptureShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_C),this);
+    connect(recaptureShortcut,&QShortcut::activated,this,&ZMainWindow::screenRecapture);
+
+    auto* windowCaptureShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_W),this);
+    connect(windowCaptureShortcut,&QShortcut::activated,this,&ZMainWindow::captureWindowUnderCursor);
+#else
     ui->btnCapture->setEnabled(false);
     ui->btnCapture->hide();
+    ui->btnWatch->setEnabled(false);
+    ui->btnWatch->hide();
 #endif
 }
 
@@ -154,6 +186,7 @@ void ZMainWindow::setupDictionaries()
     }
 
     if (kdictRes) {
+        zF->kanjiDictionary = dict.data();
         allowLookup = false;
         renderRadicalsButtons();
         renderKanaButtons();
@@ -528,6 +561,12 @@ void ZMainWindow::setScratchPadText(const QString &text)
 void ZMainWindow::screenCapture()
 {
 #ifdef WITH_OCR
+    if (QApplication::keyboardModifiers().testFlag(Qt::ShiftModifier) &&
+            lastGrabbedRegion.isValid()) {
+        screenRecapture();
+        return;
+    }
+
     hide();
     QApplication::processEvents();
 
@@ -541,39 +580,59 @@ void ZMainWindow::screenCapture()
 #endif
 }
 
+void ZMainWindow::screenRecapture()
+{
+#ifdef WITH_OCR
+    // repeat capture of remembered region directly from X, without overlay
+    if (!lastGrabbedRegion.isValid()) {
+        screenCapture();
+        return;
+    }
+
+    hide();
+    QApplication::processEvents();
+
+    QTimer::singleShot(CDefaults::screenCaptureDelay,this,[this](){
+        regionGrabbed(ZXCBTools::getScreenAreaPixmap(lastGrabbedRegion,false));
+    });
+#endif
+}
+
+void ZMainWindow::captureWindowUnderCursor()
+{
+#ifdef WITH_OCR
+    // one-click mode: client window under pointer is fetched directly, no overlay and drag
+    const xcb_window_t window = ZXCBTools::windowUnderCursor(false);
+    const QRect rect = ZXCBTools::getWindowRootGeometry(window);
+    if (window == XCB_NONE || window == ZXCBTools::appRootWindow() || !rect.isValid()) {
+        statusBar()->showMessage(tr("No window under mouse pointer."),CDefaults::dictManagerStatusMessageTimeout);
+        return;
+    }
+
+    if (isVisible() && frameGeometry().contains(QCursor::pos())) {
+        statusBar()->showMessage(tr("Point the mouse at window with text to recognize."),
+                                 CDefaults::dictManagerStatusMessageTimeout);
+        return;
+    }
+
+    regionUpdated(rect);
+    regionGrabbed(ZXCBTools::getScreenAreaPixmap(rect,false));
+#endif
+}
+
 void ZMainWindow::regionGrabbed(const QPixmap &pic)
 {
 #ifdef WITH_OCR
     const int minOCRPicSize = 20;
-    QString text;
 
     if ( !pic.isNull() )
     {
         if (zF->isOCRReady() && pic.width()>minOCRPicSize && pic.height()>minOCRPicSize) {
-            QImage cpx = pic.toImage();
-            QString s = zF->processImageWithOCR(cpx);
-            QStringList sl = s.split('\n',Qt::SkipEmptyParts);
-            int maxlen = 0;
-            for (const auto &i : std::as_const(sl)) {
-                if (i.length()>maxlen)
-                    maxlen = i.length();
-            }
-            if (maxlen<sl.count()) { // vertical kanji block, needs transpose
-                QStringList sl2;
-                sl2.reserve(maxlen);
-                for (int i=0;i<maxlen;i++)
-                    sl2 << QString(sl.count(),QChar(u' '));
-                for (int i=0;i<sl.count();i++) {
-                    for (int j=0;j<sl.at(i).length();j++)
-                        sl2[maxlen-j-1][i]=sl[i][j];
-                }
-                sl = sl2;
-            }
-            if (!sl.isEmpty()) {
-                text = sl.join(QChar(' '));
-                const QRegularExpression newlineRx(QSL("[\r\n]+"));
-                text.replace(newlineRx,QSL(" "));
-            }
+            // only latest capture is interesting for user
+            zF->ocrService->cancelAll();
+            ocrJobId = zF->ocrService->recognize(pic.toImage());
+            ocrProgress->show();
+            statusBar()->showMessage(tr("Recognizing text..."));
         }
     }
 
@@ -583,14 +642,115 @@ void ZMainWindow::regionGrabbed(const QPixmap &pic)
 
     QApplication::restoreOverrideCursor();
     restoreWindow();
+#else
+    Q_UNUSED(pic)
+#endif
+}
+
+void ZMainWindow::ocrFinished(quint64 jobId, const QString &text)
+{
+    if (jobId != 0 && jobId == ocrWatchJobId) {
+        // watch mode pushes only new text, repeated subtitles are skipped
+        ocrWatchJobId = 0;
+        ocrTimingsReport.clear();
+        if (!text.isEmpty() && text != lastWatchedText) {
+            lastWatchedText = text;
+            ui->scratchPad->setEditText(text);
+        }
+        return;
+    }
+
+    if (jobId != ocrJobId)
+        return;
+
+    ocrJobId = 0;
+    ocrProgress->hide();
+    if (ocrTimingsReport.isEmpty()) {
+        statusBar()->clearMessage();
+    } else {
+        statusBar()->showMessage(tr("OCR: %1").arg(ocrTimingsReport),CDefaults::dictManagerStatusMessageTimeout);
+    }
+    ocrTimingsReport.clear();
 
     if (!text.isEmpty())
         ui->scratchPad->setEditText(text);
+}
+
+void ZMainWindow::ocrTimings(quint64 jobId, const QString &report)
+{
+    if (jobId != ocrJobId)
+        return;
+
+    ocrTimingsReport = report;
+}
+
+void ZMainWindow::regionWatchToggled(bool checked)
+{
+#ifdef WITH_OCR
+    if (!checked) {
+        regionWatcher->stop();
+        if (ocrWatchJobId != 0 && zF->ocrService)
+            zF->ocrService->cancel(ocrWatchJobId);
+        ocrWatchJobId = 0;
+        statusBar()->clearMessage();
+        return;
+    }
+
+    if (!zF->isOCRReady() || !lastGrabbedRegion.isValid()) {
+        statusBar()->showMessage(tr("Capture a region first, then start watching it."),
+                                 CDefaults::dictManagerStatusMessageTimeout);
+        ui->btnWatch->setChecked(false);
+        return;
+    }
+
+    lastWatchedText.clear();
+    if (!regionWatcher->start(lastGrabbedRegion)) {
+        statusBar()->showMessage(tr("Unable to watch screen region, X DAMAGE extension is not available."),
+                                 CDefaults::dictManagerStatusMessageTimeout);
+        ui->btnWatch->setChecked(false);
+        return;
+    }
+
+    statusBar()->showMessage(tr("Watching region %1x%2")
+                             .arg(lastGrabbedRegion.width())
+                             .arg(lastGrabbedRegion.height()));
 #else
-    Q_UNUSED(pic)
+    Q_UNUSED(checked)
 #endif
 }
 
+void ZMainWindow::regionWatchChanged(const QImage &image)
+{
+#ifdef WITH_OCR
+    if (!zF->isOCRReady())
+        return;
+
+    // only the latest frame is interesting, stale recognition is dropped
+    if (ocrWatchJobId != 0)
+        zF->ocrService->cancel(ocrWatchJobId);
+    ocrWatchJobId = zF->ocrService->recognize(image);
+#else
+    Q_UNUSED(image)
+#endif
+}
+
+void ZMainWindow::ocrFailed(quint64 jobId, const QString &error)
+{
+    if (jobId != 0 && jobId == ocrWatchJobId) {
+        ocrWatchJobId = 0;
+        ui->btnWatch->setChecked(false);
+        statusBar()->showMessage(tr("OCR failed: %1").arg(error),CDefaults::dictManagerStatusMessageTimeout);
+        return;
+    }
+
+    if (jobId != ocrJobId)
+        return;
+
+    ocrJobId = 0;
+    ocrProgress->hide();
+    statusBar()->showMessage(tr("OCR failed: %1").arg(error),CDefaults::dictManagerStatusMessageTimeout);
+}
+
 void ZMainWindow::regionUpdated(const QRect &region)
 {
     lastGrabbedRegion = region;
@@ -652,8 +812,33 @@ void ZMainWindow::wordListSelectionChanged()
 {
     QList<QListWidgetItem *> selected = ui->dictWords->selectedItems();
 
-    if (!selected.isEmpty() )
+    if (!selected.isEmpty() ) {
         showTranslationFor(selected.front()->text());
+        prefetchArticles(ui->dictWords->row(selected.front()));
+    }
+}
+
+void ZMainWindow::prefetchArticles(int currentRow)
+{
+    QStringList words;
+    if (currentRow < 0) {
+        const int count = qMin(ui->dictWords->count(),CDefaults::prefetchArticles);
+        words.reserve(count);
+        for (int i=0; i<count; i++)
+            words.append(ui->dictWords->item(i)->text());
+    } else {
+        // closest neighbors first, user is probably arrowing through the list
+        for (int i=1; i<=CDefaults::prefetchNeighbors; i++) {
+            const QVector<int> rows({ currentRow + i, currentRow - i });
+            for (const int row : rows) {
+                if (row >= 0 && row < ui->dictWords->count())
+                    words.append(ui->dictWords->item(row)->text());
+            }
+        }
+    }
+
+    if (!words.isEmpty())
+        zF->articlePrefetcher->prefetch(words);
 }
 
 void ZMainWindow::dictLoadFinished()
@@ -733,6 +918,7 @@ void ZMainWindow::updateMatchResults(const QStringList& words)
     ui->dictWords->setUpdatesEnabled(true);
 
     updateResultsCountLabel();
+    prefetchArticles(-1);
 }
 
 void ZMainWindow::translateInputChanged(const QString &newValue)
@@ -766,7 +952,36 @@ void ZMainWindow::startWordSearch(const QString &newValue, bool fuzzy)
 
     lastWordFinderReq = req;
     fuzzySearch = fuzzy;
-    zF->dictManager->wordLookupAsync(req,false,maxDictionaryResults);
+
+    // typing ahead narrows previous complete reply, controller is asked only when it was truncated
+    const quint32 generation = zF->dictGeneration();
+    QStringList words;
+    if (wordPrefixIndex.lookup(req,maxDictionaryResults,generation,words)) {
+        updateMatchResults(words);
+        return;
+    }
+
+    // each lookup carries its own query, so reply is cached only for the prefix it was made for
+    const quint64 serial = ++wordSearchSerial;
+    const quint32 interrupts = zF->dictInterrupts();
+    wordSearchesInFlight++;
+    auto *watcher = new QFutureWatcher<QStringList>(this);
+    connect(watcher,&QFutureWatcher<QStringList>::finished,
+            this,[this,watcher,serial,interrupts,generation,req,maxDictionaryResults](){
+        wordSearchesInFlight--;
+        // drop stale results, user already started another search
+        if (serial == wordSearchSerial) {
+            const QStringList res = watcher->result();
+            // controller work cancelled by another requester may cut the list short
+            if (interrupts == zF->dictInterrupts() && generation == zF->dictGeneration())
+                wordPrefixIndex.insert(req,maxDictionaryResults,generation,res);
+            updateMatchResults(res);
+        }
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([req,maxDictionaryResults](){
+        return zF->dictManager->wordLookup(req,false,maxDictionaryResults);
+    }));
 }
 
 void ZMainWindow::updateResultsCountLabel()
@@ -786,10 +1001,28 @@ void ZMainWindow::translateInputFinished()
         showTranslationFor(word);
 }
 
-void ZMainWindow::showTranslationFor(const QString &word) const
+void ZMainWindow::showTranslationFor(const QString &word)
 {
+    const quint64 serial = ++articleRequestSerial;
+
+    QString article;
+    if (zF->articleCache->lookup(word,zF->dictGeneration(),article)) {
+        articleReady(article);
+        return;
+    }
+
     ui->wdictViewer->clear();
-    zF->dictManager->loadArticleAsync(word);
+
+    auto *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher,&QFutureWatcher<QString>::finished,this,[this,watcher,serial](){
+        // drop stale results, user already requested another article
+        if (serial == articleRequestSerial)
+            articleReady(watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([this,word](){
+        return zF->loadArticle(word,this);
+    }));
 }
 
 CAuxDictKeyFilter::CAuxDictKeyFilter(QObject *parent)
@@ -6,6 +6,7 @@
 #include <QString>
 #include <QList>
 #include <QLabel>
+#include <QProgressBar>
 #include <QModelIndex>
 #include <QListWidgetItem>
 #include <QCloseEvent>
@@ -13,6 +14,9 @@
 #include <QPixmap>
 
 #include "kdictionary.h"
+#include "wordprefixindex.h"
+
+class ZRegionWatcher;
 
 namespace Ui {
     class MainWindow;
@@ -53,16 +57,27 @@ private:
     QObjectList kanaButtons;
     QString infoKanjiTemplate;
     QString lastWordFinderReq;
+    ZWordPrefixIndex wordPrefixIndex;
     QRect lastGrabbedRegion;
     QLabel *statusMsg { nullptr };
+    QProgressBar *ocrProgress { nullptr };
+    quint64 ocrJobId { 0 };
+    QString ocrTimingsReport;
+    ZRegionWatcher *regionWatcher { nullptr };
+    quint64 ocrWatchJobId { 0 };
+    QString lastWatchedText;
     CAuxDictKeyFilter *keyFilter { nullptr };
     bool allowLookup { true };
     bool forceFocusToEdit { false };
     bool fuzzySearch { false };
+    quint64 articleRequestSerial { 0 };
+    quint64 wordSearchSerial { 0 };
+    int wordSearchesInFlight { 0 };
 
     void insertOneWidget(QWidget *w, int &row, int &clmn, bool isKana);
 
-    void showTranslationFor(const QString &word) const;
+    void showTranslationFor(const QString &word);
+    void prefetchArticles(int currentRow);
     void restoreWindow();
     void startWordSearch(const QString &newValue, bool fuzzy);
     void updateResultsCountLabel();
@@ -91,8 +106,15 @@ public Q_SLOTS:
 
     // OCR
     void screenCapture();
+    void screenRecapture();
+    void captureWindowUnderCursor();
     void regionGrabbed(const QPixmap &pic);
     void regionUpdated(const QRect &region);
+    void ocrFinished(quint64 jobId, const QString &text);
+    void ocrFailed(quint64 jobId, const QString &error);
+    void ocrTimings(quint64 jobId, const QString &report);
+    void regionWatchToggled(bool checked);
+    void regionWatchChanged(const QImage &image);
 
     // Word dictionary
     void updateMatchResults(const QStringList &words);
@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <utility>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QTextStream>
+#include <QDebug>
+
+#include "ocrbenchmark.h"
+#include "ocrservice.h"
+#include "global.h"
+#include "qsl.h"
+
+#ifdef WITH_OCR
+
+namespace CDefaults {
+const QStringList ocrBenchmarkCorpus({
+    QSL("日本語の文字認識"),
+    QSL("東京都千代田区"),
+    QSL("今日はいい天気ですね"),
+    QSL("漢字とひらがなとカタカナ"),
+    QSL("吾輩は猫である名前はまだ無い"),
+    QSL("国境の長いトンネルを抜けると雪国であった"),
+    QSL("辞書で単語を調べる"),
+    QSL("電車が駅に着きました")
+});
+const char ocrBenchmarkSizes[] = "12,16,24,32";
+const int ocrBenchmarkMarginDivisor = 2;
+const int ocrBenchmarkP50 = 50;
+const int ocrBenchmarkP95 = 95;
+const int ocrBenchmarkJobTimeoutMS = 120000;
+}
+
+ZOCRBenchmark::ZOCRBenchmark(QObject *parent)
+    : QObject(parent)
+{
+    m_stdout.open(stdout,QIODevice::WriteOnly);
+}
+
+ZOCRBenchmark::~ZOCRBenchmark()
+{
+    if (m_service)
+        m_service->stop();
+}
+
+int ZOCRBenchmark::exec(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QSL("QJRad OCR accuracy and latency benchmark"));
+    parser.addHelpOption();
+    const QCommandLineOption benchmarkOption(QSL("ocr-benchmark"),QSL("Render reference strings and recognize them "
+                                                                      "with configured OCR pipeline."));
+    const QCommandLineOption corpusOption(QSL("corpus"),QSL("Text file with one reference string per line "
+                                                            "(default: built-in Japanese corpus)."),
+                                          QSL("file"));
+    const QCommandLineOption fontOption(QSL("font"),QSL("Font family for rendering (default: first Japanese font)."),
+                                        QSL("family"));
+    const QCommandLineOption sizesOption(QSL("sizes"),QSL("Comma separated font pixel sizes."),
+                                         QSL("list"),QString::fromLatin1(CDefaults::ocrBenchmarkSizes));
+    const QCommandLineOption languageOption(QSL("language"),QSL("Tesseract language (default: active OCR language)."),
+                                            QSL("language"),zF->ocrGetActiveLanguage());
+    parser.addOptions({ benchmarkOption, corpusOption, fontOption, sizesOption, languageOption });
+    parser.process(arguments);
+
+    const QStringList corpus = parser.isSet(corpusOption) ? loadCorpus(parser.value(corpusOption))
+                                                          : CDefaults::ocrBenchmarkCorpus;
+    if (corpus.isEmpty()) {
+        qCritical() << "Benchmark corpus is empty";
+        return 1;
+    }
+
+    QFont font;
+    const QString family = parser.isSet(fontOption) ? parser.value(fontOption) : defaultFontFamily();
+    if (family.isEmpty()) {
+        qCritical() << "No font with Japanese writing system found, use --font";
+        return 1;
+    }
+    font.setFamily(family);
+    font.setStyleStrategy(QFont::PreferAntialias);
+
+    QVector<int> sizes;
+    const QStringList sizeList = parser.value(sizesOption).split(QChar(','),Qt::SkipEmptyParts);
+    for (const auto &size : sizeList) {
+        const int px = size.trimmed().toInt();
+        if (px > 0)
+            sizes.append(px);
+    }
+    if (sizes.isEmpty()) {
+        qCritical() << "No valid font sizes given";
+        return 1;
+    }
+
+    const QVector<Style> styles({ Style::Horizontal, Style::Vertical, Style::Inverted });
+    for (const auto style : styles) {
+        for (const int size : std::as_const(sizes)) {
+            font.setPixelSize(size);
+            for (const auto &text : corpus) {
+                Sample sample;
+                sample.reference = text;
+                sample.style = style;
+                sample.size = size;
+                sample.image = render(text,font,style);
+                m_samples.append(sample);
+            }
+        }
+    }
+
+    write(QSL("Font: %1, language: %2, engines: %3, samples: %4")
+          .arg(family,parser.value(languageOption))
+          .arg(zF->ocrGetEngines())
+          .arg(m_samples.count()));
+    write(QSL("Memory before start: %1").arg(memoryUsage()));
+
+    // same service setup as interactive capture, but without result cache
+    m_service = new ZOCRService(this);
+    m_service->setPreprocessOptions(ZOCRPreprocessor::Options::fromSettings());
+    connect(m_service,&ZOCRService::recognized,this,&ZOCRBenchmark::recognized,Qt::QueuedConnection);
+    connect(m_service,&ZOCRService::failed,this,&ZOCRBenchmark::failed,Qt::QueuedConnection);
+    m_service->start(zF->ocrGetEngines(),zF->ocrGetDatapath(),parser.value(languageOption));
+
+    m_jobTimeout.setSingleShot(true);
+    m_jobTimeout.setInterval(CDefaults::ocrBenchmarkJobTimeoutMS);
+    connect(&m_jobTimeout,&QTimer::timeout,this,&ZOCRBenchmark::jobTimedOut);
+
+    QEventLoop loop;
+    m_loop = &loop;
+    submitNext();
+    if (m_current < m_samples.count())
+        loop.exec();
+    m_loop = nullptr;
+
+    report();
+    m_service->stop();
+
+    return 0;
+}
+
+QStringList ZOCRBenchmark::loadCorpus(const QString &fileName)
+{
+    QStringList res;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Unable to open corpus file" << fileName;
+        return res;
+    }
+
+    QTextStream stream(&file);
+#if QT_VERSION < QT_VERSION_CHECK(6,0,0)
+    stream.setCodec("UTF-8");
+#endif
+    QString line;
+    while (stream.readLineInto(&line)) {
+        line = line.trimmed();
+        if (!line.isEmpty())
+            res.append(line);
+    }
+    return res;
+}
+
+QString ZOCRBenchmark::defaultFontFamily()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6,0,0)
+    const QStringList families = QFontDatabase::families(QFontDatabase::Japanese);
+#else
+    const QFontDatabase fontDatabase;
+    const QStringList families = fontDatabase.families(QFontDatabase::Japanese);
+#endif
+    if (families.isEmpty())
+        return QString();
+
+    return families.first();
+}
+
+QImage ZOCRBenchmark::render(const QString &text, const QFont &font, Style style)
+{
+    const QFontMetrics fm(font);
+    const int margin = qMax(1,font.pixelSize() / CDefaults::ocrBenchmarkMarginDivisor);
+
+    QSize size;
+    if (style == Style::Vertical) {
+        // one upright glyph per line, column from top to bottom
+        int columnWidth = 0;
+        for (const auto &ch : text)
+            columnWidth = qMax(columnWidth,fm.horizontalAdvance(ch));
+        size = QSize(columnWidth + 2 * margin, fm.height() * text.length() + 2 * margin);
+    } else {
+        size = QSize(fm.horizontalAdvance(text) + 2 * margin, fm.height() + 2 * margin);
+    }
+
+    // captured screen pixmaps arrive as RGB32, keep the same input format
+    QImage res(size,QImage::Format_RGB32);
+    const bool inverted = (style == Style::Inverted);
+    res.fill(inverted ? Qt::black : Qt::white);
+
+    QPainter painter(&res);
+    painter.setFont(font);
+    painter.setPen(inverted ? Qt::white : Qt::black);
+    if (style == Style::Vertical) {
+        int y = margin + fm.ascent();
+        for (const auto &ch : text) {
+            const int x = (size.width() - fm.horizontalAdvance(ch)) / 2;
+            painter.drawText(x,y,ch);
+            y += fm.height();
+        }
+    } else {
+        painter.drawText(margin,margin + fm.ascent(),text);
+    }
+    painter.end();
+
+    return res;
+}
+
+QString ZOCRBenchmark::styleName(Style style)
+{
+    switch (style) {
+        case Style::Horizontal: return QSL("horizontal");
+        case Style::Vertical: return QSL("vertical");
+        case Style::Inverted: return QSL("inverted");
+    }
+    return QString();
+}
+
+int ZOCRBenchmark::editDistance(const QString &reference, const QString &text)
+{
+    // whitespace placement is not a recognition error for Japanese text
+    QString a = reference;
+    QString b = text;
+    a.remove(QChar(' '));
+    b.remove(QChar(' '));
+
+    QVector<int> prev(b.length() + 1);
+    QVector<int> cur(b.length() + 1);
+    for (int j = 0; j <= b.length(); j++)
+        prev[j] = j;
+
+    for (int i = 1; i <= a.length(); i++) {
+        cur[0] = i;
+        for (int j = 1; j <= b.length(); j++) {
+            const int cost = (a.at(i - 1) == b.at(j - 1)) ? 0 : 1;
+            cur[j] = std::min({ prev[j] + 1, cur[j - 1] + 1, prev[j - 1] + cost });
+        }
+        prev.swap(cur);
+    }
+    return prev.at(b.length());
+}
+
+qint64 ZOCRBenchmark::percentile(QVector<qint64> values, int percent)
+{
+    if (values.isEmpty())
+        return 0;
+
+    const int idx = qBound(0,(values.count() * percent + 99) / 100 - 1,values.count() - 1);
+    std::nth_element(values.begin(),values.begin() + idx,values.end());
+    return values.at(idx);
+}
+
+QString ZOCRBenchmark::memoryUsage()
+{
+    QString res;
+    QFile file(QSL("/proc/self/status"));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return QSL("unavailable");
+
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const auto &line : lines) {
+        if (line.startsWith("VmRSS:") || line.startsWith("VmHWM:")) {
+            if (!res.isEmpty())
+                res.append(QSL(", "));
+            res.append(QString::fromLatin1(line.simplified()));
+        }
+    }
+    return res;
+}
+
+void ZOCRBenchmark::submitNext()
+{
+    m_current++;
+    if (m_current >= m_samples.count()) {
+        m_jobTimeout.stop();
+        if (m_loop)
+            m_loop->quit();
+        return;
+    }
+
+    // one job at a time, latency includes preprocessing, layout analysis and recognition
+    m_jobTimer.start();
+    m_jobId = m_service->recognize(m_samples.at(m_current).image);
+    m_jobTimeout.start();
+}
+
+void ZOCRBenchmark::recognized(quint64 jobId, const QString &text)
+{
+    if (jobId != m_jobId)
+        return;
+
+    Sample &sample = m_samples[m_current];
+    sample.latencyNS = m_jobTimer.nsecsElapsed();
+    sample.edits = editDistance(sample.reference,text);
+    sample.image = QImage();
+    submitNext();
+}
+
+void ZOCRBenchmark::failed(quint64 jobId, const QString &error)
+{
+    if (jobId != m_jobId)
+        return;
+
+    Sample &sample = m_samples[m_current];
+    sample.latencyNS = m_jobTimer.nsecsElapsed();
+    sample.edits = sample.reference.length();
+    sample.failed = true;
+    sample.image = QImage();
+    qWarning() << "OCR failed for" << sample.reference << error;
+    submitNext();
+}
+
+void ZOCRBenchmark::jobTimedOut()
+{
+    // result lost or engine stuck, sample is counted as failed and run goes on
+    m_service->cancel(m_jobId);
+    failed(m_jobId,QSL("Recognition timed out"));
+}
+
+void ZOCRBenchmark::report()
+{
+    const auto formatLine = [](const QString &name, const QVector<const Sample *> &group) -> QString {
+        qint64 edits = 0;
+        qint64 chars = 0;
+        int failures = 0;
+        QVector<qint64> latencies;
+        latencies.reserve(group.count());
+        for (const auto *sample : group) {
+            edits += sample->edits;
+            chars += sample->reference.length();
+            latencies.append(sample->latencyNS);
+            if (sample->failed)
+                failures++;
+        }
+        const double cer = (chars > 0) ? 100.0 * static_cast<double>(edits) / static_cast<double>(chars) : 0.0;
+        return QSL("%1 %2 %3 %4 %5 %6")
+                .arg(name,-16)
+                .arg(group.count(),7)
+                .arg(failures,6)
+                .arg(cer,7,'f',2)
+                .arg(static_cast<double>(percentile(latencies,CDefaults::ocrBenchmarkP50)) / 1.0e6,9,'f',1)
+                .arg(static_cast<double>(percentile(latencies,CDefaults::ocrBenchmarkP95)) / 1.0e6,9,'f',1);
+    };
+
+    write(QSL("%1 %2 %3 %4 %5 %6")
+          .arg(QSL("group"),-16)
+          .arg(QSL("samples"),7)
+          .arg(QSL("failed"),6)
+          .arg(QSL("CER, %"),7)
+          .arg(QSL("p50, ms"),9)
+          .arg(QSL("p95, ms"),9));
+
+    QVector<const Sample *> all;
+    all.reserve(m_samples.count());
+    QVector<const Sample *> group;
+    for (int i = 0; i < m_samples.count(); i++) {
+        const Sample &sample = m_samples.at(i);
+        all.append(&sample);
+        group.append(&sample);
+
+        const bool last = (i + 1 == m_samples.count());
+        if (last || m_samples.at(i + 1).style != sample.style || m_samples.at(i + 1).size != sample.size) {
+            write(formatLine(QSL("%1 %2px").arg(styleName(sample.style)).arg(sample.size),group));
+            group.clear();
+        }
+    }
+    write(formatLine(QSL("total"),all));
+    write(QSL("Memory after run: %1").arg(memoryUsage()));
+}
+
+void ZOCRBenchmark::write(const QString &line)
+{
+    m_stdout.write(line.toUtf8());
+    m_stdout.write("\n");
+    m_stdout.flush();
+}
+
+#endif // WITH_OCR
@@ -0,0 +1,71 @@
+#ifndef OCRBENCHMARK_H
+#define OCRBENCHMARK_H
+
+#ifdef WITH_OCR
+
+#include <QObject>
+#include <QFile>
+#include <QFont>
+#include <QImage>
+#include <QVector>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTimer>
+
+class QEventLoop;
+class ZOCRService;
+
+class ZOCRBenchmark : public QObject
+{
+    Q_OBJECT
+private:
+    enum class Style { Horizontal, Vertical, Inverted };
+
+    class Sample {
+    public:
+        QString reference;
+        QImage image;
+        Style style { Style::Horizontal };
+        int size { 0 };
+        int edits { 0 };
+        qint64 latencyNS { 0 };
+        bool failed { false };
+    };
+
+    QFile m_stdout;
+    ZOCRService* m_service { nullptr };
+    QEventLoop* m_loop { nullptr };
+    QVector<Sample> m_samples;
+    QElapsedTimer m_jobTimer;
+    QTimer m_jobTimeout;
+    quint64 m_jobId { 0 };
+    int m_current { -1 };
+
+    static QStringList loadCorpus(const QString &fileName);
+    static QString defaultFontFamily();
+    static QImage render(const QString &text, const QFont &font, Style style);
+    static QString styleName(Style style);
+    static int editDistance(const QString &reference, const QString &text);
+    static qint64 percentile(QVector<qint64> values, int percent);
+    static QString memoryUsage();
+
+    void submitNext();
+    void report();
+    void write(const QString &line);
+
+private Q_SLOTS:
+    void recognized(quint64 jobId, const QString &text);
+    void failed(quint64 jobId, const QString &error);
+    void jobTimedOut();
+
+public:
+    explicit ZOCRBenchmark(QObject *parent = nullptr);
+    ~ZOCRBenchmark() override;
+
+    int exec(const QStringList &arguments);
+
+};
+
+#endif // WITH_OCR
+
+#endif // OCRBENCHMARK_H
@@ -0,0 +1,307 @@
+#include <QMutexLocker>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QVector>
+#include <QDebug>
+#include "ocrcache.h"
+#include "qsl.h"
+
+#ifdef WITH_OCR
+
+#include <array>
+#include <limits>
+
+namespace CDefaults {
+const quint32 ocrCacheMagic = 0x514a4f43; // QJOC
+const quint32 ocrCacheVersion = 1;
+const int ocrHashWidth = 9;
+const int ocrHashHeight = 8;
+const qint64 ocrCacheEntryOverhead = 64;
+}
+
+ZOCRCache::ZOCRCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ZOCRCache::~ZOCRCache() = default;
+
+void ZOCRCache::setMaxBytes(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxBytes = qMax<qint64>(0,bytes);
+    evict();
+}
+
+bool ZOCRCache::load(const QString &fileName)
+{
+    QMutexLocker locker(&m_mutex);
+    m_fileName = fileName;
+    m_buckets.clear();
+    m_usedBytes = 0;
+    m_count = 0;
+    m_stamp = 0;
+    m_dirty = false;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_10);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != CDefaults::ocrCacheMagic || version != CDefaults::ocrCacheVersion) {
+        qWarning() << "Incompatible OCR cache file, ignored" << fileName;
+        return false;
+    }
+
+    qint32 count = 0;
+    in >> count;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        quint64 phash = 0;
+        Entry entry;
+        in >> phash >> entry.digest >> entry.text >> entry.stamp;
+        if (in.status() != QDataStream::Ok)
+            break;
+        m_stamp = qMax(m_stamp,entry.stamp);
+        m_usedBytes += entry.cost();
+        m_count++;
+        m_buckets[phash].append(entry);
+    }
+
+    if (in.status() != QDataStream::Ok)
+        qWarning() << "OCR cache file is truncated" << fileName;
+
+    return true;
+}
+
+bool ZOCRCache::save()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_dirty || m_fileName.isEmpty())
+        return true;
+
+    // atomic replace, interrupted save never corrupts previous cache
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Unable to save OCR cache" << m_fileName;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_10);
+    out << CDefaults::ocrCacheMagic << CDefaults::ocrCacheVersion << static_cast<qint32>(m_count);
+    for (auto it = m_buckets.constBegin(), end = m_buckets.constEnd(); it != end; ++it) {
+        for (const auto &entry : it.value())
+            out << it.key() << entry.digest << entry.text << entry.stamp;
+    }
+
+    if (!file.commit()) {
+        qWarning() << "Unable to save OCR cache" << m_fileName;
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+bool ZOCRCache::lookup(const QImage &gray, const QString &context, QString &text)
+{
+    const quint64 phash = perceptualHash(gray);
+
+    QMutexLocker locker(&m_mutex);
+    auto bucket = m_buckets.find(phash);
+    if (bucket == m_buckets.end() || bucket.value().isEmpty()) {
+        m_misses++;
+        return false;
+    }
+    locker.unlock();
+
+    // exact hash is only calculated for perceptual candidates
+    const QByteArray digest = exactHash(gray,context);
+
+    locker.relock();
+    bucket = m_buckets.find(phash);
+    if (bucket != m_buckets.end()) {
+        for (auto &entry : bucket.value()) {
+            if (entry.digest == digest) {
+                entry.stamp = ++m_stamp;
+                text = entry.text;
+                m_hits++;
+                m_dirty = true;
+                return true;
+            }
+        }
+    }
+
+    m_misses++;
+    return false;
+}
+
+void ZOCRCache::insert(const QImage &gray, const QString &context, const QString &text)
+{
+    const quint64 phash = perceptualHash(gray);
+    Entry entry;
+    entry.digest = exactHash(gray,context);
+    entry.text = text;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_maxBytes <= 0)
+        return;
+
+    QList<Entry> &bucket = m_buckets[phash];
+    for (int i = 0; i < bucket.count(); i++) {
+        if (bucket.at(i).digest == entry.digest) {
+            m_usedBytes -= bucket.at(i).cost();
+            m_count--;
+            bucket.removeAt(i);
+            break;
+        }
+    }
+
+    entry.stamp = ++m_stamp;
+    m_usedBytes += entry.cost();
+    m_count++;
+    bucket.append(entry);
+    m_insertions++;
+    m_dirty = true;
+    evict();
+}
+
+void ZOCRCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_buckets.clear();
+    m_usedBytes = 0;
+    m_count = 0;
+    m_dirty = true;
+}
+
+ZOCRCache::Statistics ZOCRCache::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    Statistics res;
+    res.hits = m_hits;
+    res.misses = m_misses;
+    res.insertions = m_insertions;
+    res.evictions = m_evictions;
+    res.usedBytes = m_usedBytes;
+    res.maxBytes = m_maxBytes;
+    res.count = m_count;
+    return res;
+}
+
+void ZOCRCache::evict()
+{
+    // cache holds at most a few thousand short texts, linear scan for the oldest entry is cheap
+    while (m_usedBytes > m_maxBytes && m_count > 0) {
+        auto oldestBucket = m_buckets.end();
+        int oldestIdx = -1;
+        quint64 oldestStamp = std::numeric_limits<quint64>::max();
+        for (auto it = m_buckets.begin(), end = m_buckets.end(); it != end; ++it) {
+            for (int i = 0; i < it.value().count(); i++) {
+                if (it.value().at(i).stamp < oldestStamp) {
+                    oldestStamp = it.value().at(i).stamp;
+                    oldestBucket = it;
+                    oldestIdx = i;
+                }
+            }
+        }
+        if (oldestIdx < 0)
+            break;
+
+        m_usedBytes -= oldestBucket.value().at(oldestIdx).cost();
+        m_count--;
+        m_evictions++;
+        m_dirty = true;
+        oldestBucket.value().removeAt(oldestIdx);
+        if (oldestBucket.value().isEmpty())
+            m_buckets.erase(oldestBucket);
+    }
+}
+
+quint64 ZOCRCache::perceptualHash(const QImage &gray)
+{
+    // difference hash: 9x8 block means, one bit per horizontal neighbour comparison
+    if (gray.isNull() || gray.format() != QImage::Format_Grayscale8)
+        return 0;
+
+    const int w = gray.width();
+    const int h = gray.height();
+    std::array<quint64,CDefaults::ocrHashWidth * CDefaults::ocrHashHeight> sums {};
+    std::array<quint64,CDefaults::ocrHashWidth * CDefaults::ocrHashHeight> counts {};
+    std::array<int,CDefaults::ocrHashWidth> columnBlocks {};
+
+    QVector<int> blockX(w);
+    for (int x = 0; x < w; x++) {
+        blockX[x] = x * CDefaults::ocrHashWidth / w;
+        columnBlocks.at(blockX.at(x))++;
+    }
+
+    for (int y = 0; y < h; y++) {
+        const int row = (y * CDefaults::ocrHashHeight / h) * CDefaults::ocrHashWidth;
+        const uchar *line = gray.constScanLine(y);
+        for (int x = 0; x < w; x++)
+            sums.at(row + blockX.at(x)) += line[x]; // NOLINT
+        for (int bx = 0; bx < CDefaults::ocrHashWidth; bx++)
+            counts.at(row + bx) += static_cast<quint64>(columnBlocks.at(bx));
+    }
+
+    quint64 res = 0;
+    for (int by = 0; by < CDefaults::ocrHashHeight; by++) {
+        for (int bx = 0; bx < CDefaults::ocrHashWidth - 1; bx++) {
+            const int idx = by * CDefaults::ocrHashWidth + bx;
+            // compare means without division: a/ca > b/cb <=> a*cb > b*ca
+            const bool brighter = (sums.at(idx) * counts.at(idx + 1) > sums.at(idx + 1) * counts.at(idx));
+            res = (res << 1U) | (brighter ? 1U : 0U);
+        }
+    }
+    return res;
+}
+
+QByteArray ZOCRCache::exactHash(const QImage &gray, const QString &context)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(context.toUtf8());
+    hash.addData(QByteArray::number(gray.width()) + 'x' + QByteArray::number(gray.height()));
+    const int lineBytes = gray.width() * gray.depth() / 8; // NOLINT
+    for (int y = 0; y < gray.height(); y++) {
+        // padding bytes at the end of scanline are undefined
+        hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(gray.constScanLine(y)),lineBytes));
+    }
+    return hash.result();
+}
+
+qint64 ZOCRCache::Entry::cost() const
+{
+    return digest.size() + text.size() * static_cast<qint64>(sizeof(QChar)) + CDefaults::ocrCacheEntryOverhead;
+}
+
+double ZOCRCache::Statistics::hitRatio() const
+{
+    const quint64 total = hits + misses;
+    if (total == 0)
+        return 0.0;
+
+    return static_cast<double>(hits) / static_cast<double>(total);
+}
+
+QString ZOCRCache::Statistics::toString() const
+{
+    return QSL("OCR cache: %1 entries, %2/%3 bytes, hit ratio %4% (%5 hits, %6 misses), "
+               "%7 insertions, %8 evictions")
+            .arg(count)
+            .arg(usedBytes)
+            .arg(maxBytes)
+            .arg(hitRatio()*100.0,0,'f',1)
+            .arg(hits)
+            .arg(misses)
+            .arg(insertions)
+            .arg(evictions);
+}
+
+#endif // WITH_OCR
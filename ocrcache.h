@@ -0,0 +1,75 @@
+#ifndef OCRCACHE_H
+#define OCRCACHE_H
+
+#ifdef WITH_OCR
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QImage>
+#include <QString>
+#include <QByteArray>
+
+class ZOCRCache : public QObject
+{
+    Q_OBJECT
+public:
+    class Statistics {
+    public:
+        quint64 hits { 0 };
+        quint64 misses { 0 };
+        quint64 insertions { 0 };
+        quint64 evictions { 0 };
+        qint64 usedBytes { 0 };
+        qint64 maxBytes { 0 };
+        int count { 0 };
+        double hitRatio() const;
+        QString toString() const;
+    };
+
+    explicit ZOCRCache(QObject *parent = nullptr);
+    ~ZOCRCache() override;
+
+    void setMaxBytes(qint64 bytes);
+    bool load(const QString &fileName);
+    bool save();
+
+    bool lookup(const QImage &gray, const QString &context, QString &text);
+    void insert(const QImage &gray, const QString &context, const QString &text);
+    void clear();
+    Statistics statistics() const;
+
+    static quint64 perceptualHash(const QImage &gray);
+    static QByteArray exactHash(const QImage &gray, const QString &context);
+
+private:
+    class Entry {
+    public:
+        QByteArray digest;
+        QString text;
+        quint64 stamp { 0 };
+        qint64 cost() const;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<quint64,QList<Entry> > m_buckets;
+    QString m_fileName;
+    qint64 m_maxBytes { 0 };
+    qint64 m_usedBytes { 0 };
+    int m_count { 0 };
+    quint64 m_stamp { 0 };
+    quint64 m_hits { 0 };
+    quint64 m_misses { 0 };
+    quint64 m_insertions { 0 };
+    quint64 m_evictions { 0 };
+    bool m_dirty { false };
+
+    void evict();
+
+    Q_DISABLE_COPY(ZOCRCache)
+};
+
+#endif // WITH_OCR
+
+#endif // OCRCACHE_H
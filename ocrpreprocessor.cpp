@@ -0,0 +1,237 @@
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QStringList>
+#include "ocrpreprocessor.h"
+#include "imagekernels.h"
+#include "qsl.h"
+
+#ifdef WITH_OCR
+
+#include <array>
+#include <cstring>
+
+namespace CDefaults {
+const int ocrHistogramSize = 256;
+const int ocrContrastClipPercent = 1;
+const int ocrMinContrastRange = 32;
+const int ocrBinarizeWindowDivider = 8;
+const int ocrBinarizeBiasPercent = 15;
+const int ocrBinarizeMaxPixels = 16 * 1024 * 1024;
+const int ocrSmallTextHeight = 48;
+const int ocrSmallRegionSize = 600;
+const int ocrMaxUpscale = 4;
+}
+
+ZOCRPreprocessor::Options ZOCRPreprocessor::Options::fromSettings()
+{
+    Options res;
+    QSettings stg;
+    stg.beginGroup(QSL("OCR"));
+    res.enabled = stg.value(QSL("preprocess"),res.enabled).toBool();
+    res.autoInvert = stg.value(QSL("preprocessInvert"),res.autoInvert).toBool();
+    res.normalizeContrast = stg.value(QSL("preprocessContrast"),res.normalizeContrast).toBool();
+    res.binarize = stg.value(QSL("preprocessBinarize"),res.binarize).toBool();
+    res.upscale = stg.value(QSL("preprocessUpscale"),res.upscale).toInt();
+    stg.endGroup();
+    return res;
+}
+
+void ZOCRPreprocessor::Options::toSettings() const
+{
+    QSettings stg;
+    stg.beginGroup(QSL("OCR"));
+    stg.setValue(QSL("preprocess"),enabled);
+    stg.setValue(QSL("preprocessInvert"),autoInvert);
+    stg.setValue(QSL("preprocessContrast"),normalizeContrast);
+    stg.setValue(QSL("preprocessBinarize"),binarize);
+    stg.setValue(QSL("preprocessUpscale"),upscale);
+    stg.endGroup();
+}
+
+QString ZOCRPreprocessor::Result::timingsReport() const
+{
+    const double nsInMs = 1000000.0;
+    QStringList res;
+    res.reserve(timings.count());
+    for (const auto &stage : timings)
+        res.append(QSL("%1 %2 ms").arg(stage.first).arg(static_cast<double>(stage.second) / nsInMs,0,'f',2));
+    return res.join(QSL(", "));
+}
+
+ZOCRPreprocessor::Result ZOCRPreprocessor::process(const QImage &image, const Options &options)
+{
+    Result res;
+    QElapsedTimer timer;
+
+    timer.start();
+    res.image = toGrayscale(image);
+    res.timings.append(qMakePair(QSL("grayscale"),timer.nsecsElapsed()));
+
+    if (!options.enabled || res.image.isNull())
+        return res;
+
+    if (options.autoInvert) {
+        timer.restart();
+        if (isLightOnDark(res.image))
+            ZImageKernels::invert(res.image.bits(),static_cast<int>(res.image.sizeInBytes()));
+        res.timings.append(qMakePair(QSL("invert"),timer.nsecsElapsed()));
+    }
+
+    if (options.normalizeContrast) {
+        timer.restart();
+        normalizeContrast(res.image);
+        res.timings.append(qMakePair(QSL("contrast"),timer.nsecsElapsed()));
+    }
+
+    if (options.binarize) {
+        timer.restart();
+        binarize(res.image);
+        res.timings.append(qMakePair(QSL("binarize"),timer.nsecsElapsed()));
+    }
+
+    int factor = options.upscale;
+    if (factor <= 0)
+        factor = autoUpscaleFactor(res.image);
+    factor = qBound(1,factor,CDefaults::ocrMaxUpscale);
+    if (factor > 1) {
+        timer.restart();
+        res.image = upscale(res.image,factor);
+        res.timings.append(qMakePair(QSL("upscale x%1").arg(factor),timer.nsecsElapsed()));
+    }
+
+    return res;
+}
+
+QImage ZOCRPreprocessor::toGrayscale(const QImage &image)
+{
+    if (image.format() == QImage::Format_Grayscale8)
+        return image;
+
+    QImage src = image;
+    if (src.format() != QImage::Format_RGB32 &&
+            src.format() != QImage::Format_ARGB32 &&
+            src.format() != QImage::Format_ARGB32_Premultiplied) {
+        src = src.convertToFormat(QImage::Format_RGB32);
+    }
+
+    QImage res(src.size(),QImage::Format_Grayscale8);
+    for (int y = 0; y < src.height(); y++) {
+        ZImageKernels::rgb32ToGray(reinterpret_cast<const quint32 *>(src.constScanLine(y)),
+                                   res.scanLine(y),src.width());
+    }
+    return res;
+}
+
+bool ZOCRPreprocessor::isLightOnDark(const QImage &gray)
+{
+    // background dominates the picture, so dark median means light text on dark background
+    std::array<quint32,CDefaults::ocrHistogramSize> hist {};
+    std::array<quint32,CDefaults::ocrHistogramSize> rowHist {};
+    for (int y = 0; y < gray.height(); y++) {
+        ZImageKernels::histogram(gray.constScanLine(y),gray.width(),rowHist.data());
+        for (int i = 0; i < CDefaults::ocrHistogramSize; i++)
+            hist.at(i) += rowHist.at(i);
+    }
+
+    const quint64 half = static_cast<quint64>(gray.width()) * static_cast<quint64>(gray.height()) / 2;
+    quint64 acc = 0;
+    for (int i = 0; i < CDefaults::ocrHistogramSize; i++) {
+        acc += hist.at(i);
+        if (acc > half)
+            return (i < CDefaults::ocrHistogramSize / 2);
+    }
+    return false;
+}
+
+void ZOCRPreprocessor::normalizeContrast(QImage &gray)
+{
+    std::array<quint32,CDefaults::ocrHistogramSize> hist {};
+    std::array<quint32,CDefaults::ocrHistogramSize> rowHist {};
+    for (int y = 0; y < gray.height(); y++) {
+        ZImageKernels::histogram(gray.constScanLine(y),gray.width(),rowHist.data());
+        for (int i = 0; i < CDefaults::ocrHistogramSize; i++)
+            hist.at(i) += rowHist.at(i);
+    }
+
+    // clip outliers (antialiasing, cursor, etc) from both ends of histogram
+    const quint64 total = static_cast<quint64>(gray.width()) * static_cast<quint64>(gray.height());
+    const quint64 clip = total * CDefaults::ocrContrastClipPercent / 100;
+    int lo = 0;
+    quint64 acc = 0;
+    while (lo < CDefaults::ocrHistogramSize - 1 && (acc + hist.at(lo)) <= clip)
+        acc += hist.at(lo++);
+    int hi = CDefaults::ocrHistogramSize - 1;
+    acc = 0;
+    while (hi > 0 && (acc + hist.at(hi)) <= clip)
+        acc += hist.at(hi--);
+
+    if ((hi - lo) < CDefaults::ocrMinContrastRange)
+        return; // flat picture, stretching would only amplify noise
+
+    for (int y = 0; y < gray.height(); y++) {
+        ZImageKernels::stretchContrast(gray.constScanLine(y),gray.scanLine(y),gray.width(),
+                                       static_cast<quint8>(lo),static_cast<quint8>(hi));
+    }
+}
+
+void ZOCRPreprocessor::binarize(QImage &gray)
+{
+    // Bradley adaptive threshold over integral image, pixel is dark when it is
+    // noticeably darker than the mean of its neighborhood
+    const int w = gray.width();
+    const int h = gray.height();
+    if (static_cast<qint64>(w) * h > CDefaults::ocrBinarizeMaxPixels)
+        return;
+
+    const int stride = w + 1;
+    QVector<quint32> integral(stride * (h + 1),0);
+    for (int y = 0; y < h; y++) {
+        const uchar *line = gray.constScanLine(y);
+        quint32 rowSum = 0;
+        for (int x = 0; x < w; x++) {
+            rowSum += line[x]; // NOLINT
+            integral[(y + 1) * stride + x + 1] = integral.at(y * stride + x + 1) + rowSum;
+        }
+    }
+
+    const int s2 = qMax(1,qMax(w,h) / CDefaults::ocrBinarizeWindowDivider / 2);
+    QVector<quint8> threshold(w);
+    for (int y = 0; y < h; y++) {
+        const int y1 = qMax(0,y - s2);
+        const int y2 = qMin(h - 1,y + s2);
+        for (int x = 0; x < w; x++) {
+            const int x1 = qMax(0,x - s2);
+            const int x2 = qMin(w - 1,x + s2);
+            const quint32 count = static_cast<quint32>((x2 - x1 + 1) * (y2 - y1 + 1));
+            const quint32 sum = integral.at((y2 + 1) * stride + x2 + 1) - integral.at(y1 * stride + x2 + 1)
+                                - integral.at((y2 + 1) * stride + x1) + integral.at(y1 * stride + x1);
+            threshold[x] = static_cast<quint8>(static_cast<quint64>(sum) * (100 - CDefaults::ocrBinarizeBiasPercent)
+                                               / (static_cast<quint64>(count) * 100));
+        }
+        ZImageKernels::thresholdRow(gray.constScanLine(y),threshold.constData(),gray.scanLine(y),w);
+    }
+}
+
+int ZOCRPreprocessor::autoUpscaleFactor(const QImage &gray)
+{
+    // screen fonts are much smaller than what Tesseract was trained on
+    if (gray.height() < CDefaults::ocrSmallTextHeight)
+        return 3;
+    if (qMax(gray.width(),gray.height()) < CDefaults::ocrSmallRegionSize)
+        return 2;
+    return 1;
+}
+
+QImage ZOCRPreprocessor::upscale(const QImage &gray, int factor)
+{
+    QImage res(gray.width() * factor,gray.height() * factor,QImage::Format_Grayscale8);
+    for (int y = 0; y < gray.height(); y++) {
+        uchar *first = res.scanLine(y * factor);
+        ZImageKernels::upscaleRow(gray.constScanLine(y),first,gray.width(),factor);
+        for (int k = 1; k < factor; k++)
+            memcpy(res.scanLine(y * factor + k),first,static_cast<size_t>(res.width()));
+    }
+    return res;
+}
+
+#endif // WITH_OCR
@@ -0,0 +1,48 @@
+#ifndef OCRPREPROCESSOR_H
+#define OCRPREPROCESSOR_H
+
+#ifdef WITH_OCR
+
+#include <QImage>
+#include <QVector>
+#include <QPair>
+#include <QString>
+
+class ZOCRPreprocessor
+{
+public:
+    class Options {
+    public:
+        bool enabled { false };
+        bool autoInvert { true };
+        bool normalizeContrast { true };
+        bool binarize { false };
+        int upscale { 0 }; // 0 - auto, 1 - disabled, 2..4 - fixed factor
+
+        static Options fromSettings();
+        void toSettings() const;
+    };
+
+    class Result {
+    public:
+        QImage image;
+        QVector<QPair<QString,qint64> > timings; // stage name, nanoseconds
+        QString timingsReport() const;
+    };
+
+    static Result process(const QImage &image, const Options &options);
+    static QImage toGrayscale(const QImage &image);
+
+private:
+    ZOCRPreprocessor() = default;
+
+    static bool isLightOnDark(const QImage &gray);
+    static void normalizeContrast(QImage &gray);
+    static void binarize(QImage &gray);
+    static int autoUpscaleFactor(const QImage &gray);
+    static QImage upscale(const QImage &gray, int factor);
+};
+
+#endif // WITH_OCR
+
+#endif // OCRPREPROCESSOR_H
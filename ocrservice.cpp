@@ -0,0 +1,607 @@
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QDebug>
+#include <QVector>
+#include <QDir>
+#include <QFileInfo>
+#include "ocrservice.h"
+#include "imagekernels.h"
+#include "qsl.h"
+
+#ifdef WITH_OCR
+
+#include <memory>
+#include <functional>
+#include <algorithm>
+#if TESSERACT_MAJOR_VERSION>=4
+#include <tesseract/ocrclass.h>
+#endif
+#include <tesseract/pageiterator.h>
+
+namespace {
+
+class ZOCRCancelState {
+public:
+    std::function<bool()> check;
+};
+
+#if TESSERACT_MAJOR_VERSION>=4
+bool ocrCancelFunc(void* cancel_this, int words)
+{
+    Q_UNUSED(words)
+    auto* state = static_cast<ZOCRCancelState *>(cancel_this);
+    return state->check();
+}
+#endif
+
+}
+
+#if TESSERACT_MAJOR_VERSION>=5
+const auto ocrVerticalTextBlock = tesseract::PT_VERTICAL_TEXT;
+#else
+const auto ocrVerticalTextBlock = PT_VERTICAL_TEXT;
+#endif
+
+namespace CDefaults {
+const int ocrBlockMargin = 4;
+const int ocrMinBlockSize = 8;
+}
+
+ZOCRService::ZOCRService(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ZOCRService::~ZOCRService()
+{
+    stop();
+}
+
+void ZOCRService::start(int engines, const QString &datapath, const QString &language)
+{
+    stop();
+
+    QMutexLocker locker(&m_mutex);
+    m_terminate = false;
+    m_datapath = datapath;
+    m_language = language;
+
+    // dedicated vertical model is much better for tategaki than generic one with vertical PSM
+    m_verticalLanguage.clear();
+    const QString vertLanguage = QSL("%1_vert").arg(language);
+    if (!language.isEmpty() && !language.endsWith(QSL("_vert")) &&
+            QFileInfo::exists(QDir(datapath).filePath(QSL("%1.traineddata").arg(vertLanguage)))) {
+        m_verticalLanguage = vertLanguage;
+    }
+
+    // each worker owns its own TessBaseAPI, engines are not thread-safe
+    for (int i=0; i<qMax(1,engines); i++) {
+        QThread* th = QThread::create([this]{
+            workerLoop();
+        });
+        m_threads.append(th);
+        th->start();
+    }
+}
+
+void ZOCRService::stop()
+{
+    QList<QThread*> threads;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_terminate = true;
+        m_queue.clear();
+        threads = m_threads;
+        m_threads.clear();
+    }
+    m_wakeup.wakeAll();
+
+    for (QThread* th : std::as_const(threads)) {
+        th->wait();
+        delete th;
+    }
+}
+
+bool ZOCRService::isReady() const
+{
+    QMutexLocker locker(&m_mutex);
+    return (!m_threads.isEmpty() && !m_language.isEmpty());
+}
+
+quint64 ZOCRService::recognize(const QImage &image)
+{
+    QMutexLocker locker(&m_mutex);
+    Job job;
+    job.id = ++m_nextJobId;
+    job.image = image;
+    job.queued.start();
+    m_queue.append(job);
+    m_wakeup.wakeOne();
+    return job.id;
+}
+
+void ZOCRService::cancel(quint64 jobId)
+{
+    QMutexLocker locker(&m_mutex);
+    QSharedPointer<Page> page;
+    int removedBlocks = 0;
+    for (int i=m_queue.count()-1; i>=0; i--) {
+        const Job &job = m_queue.at(i);
+        if (job.id != jobId)
+            continue;
+        if (job.block < 0) {
+            // whole job is still queued, nothing is running
+            m_queue.removeAt(i);
+            return;
+        }
+        page = job.page;
+        removedBlocks++;
+        m_queue.removeAt(i);
+    }
+
+    if (page) {
+        QMutexLocker pageLocker(&page->mutex);
+        page->remaining -= removedBlocks;
+        if (page->remaining <= 0)
+            return;
+    }
+
+    // job is already running, recognizer will stop at next cancel check
+    m_cancelled.insert(jobId);
+}
+
+void ZOCRService::cancelAll()
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    m_cancelledBefore = m_nextJobId;
+}
+
+int ZOCRService::pendingJobs() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queue.count();
+}
+
+void ZOCRService::setPreprocessOptions(const ZOCRPreprocessor::Options &options)
+{
+    QMutexLocker locker(&m_mutex);
+    m_preprocess = options;
+}
+
+void ZOCRService::setResultCache(ZOCRCache *cache)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache = cache;
+}
+
+ZOCRCache *ZOCRService::resultCache(QString *context) const
+{
+    // recognized text depends on the models, not only on the picture
+    QMutexLocker locker(&m_mutex);
+    *context = QSL("%1|%2").arg(m_language,m_verticalLanguage);
+    return m_cache;
+}
+
+bool ZOCRService::isCancelled(quint64 jobId) const
+{
+    QMutexLocker locker(&m_mutex);
+    return (m_terminate || jobId <= m_cancelledBefore || m_cancelled.contains(jobId));
+}
+
+void ZOCRService::workerLoop()
+{
+    QByteArray datapath;
+    QByteArray language;
+    {
+        QMutexLocker locker(&m_mutex);
+        datapath = m_datapath.toUtf8();
+        language = m_language.toUtf8();
+    }
+
+    auto api = std::make_unique<tesseract::TessBaseAPI>();
+    const bool initialized = (!language.isEmpty() && api->Init(datapath.constData(),language.constData()) == 0);
+    if (!initialized) {
+        qCritical() << "Could not initialize Tesseract. "
+                       "Maybe language training data is not installed.";
+    }
+
+    Engines engines;
+    engines.horizontal = api.get();
+
+    QMutexLocker locker(&m_mutex);
+    while (!m_terminate) {
+        if (m_queue.isEmpty()) {
+            m_wakeup.wait(&m_mutex);
+            continue;
+        }
+
+        const Job job = m_queue.takeFirst();
+        const ZOCRPreprocessor::Options options = m_preprocess;
+        locker.unlock();
+
+        bool spawned = false;
+        if (job.block >= 0) {
+            if (initialized) {
+                processBlock(&engines,job);
+            } else {
+                finishBlock(job,QString(),true);
+            }
+        } else if (!initialized) {
+            Q_EMIT failed(job.id,tr("Tesseract is not initialized"));
+        } else {
+            spawned = processPage(&engines,job,options);
+        }
+
+        locker.relock();
+        // spawned blocks clean up cancel mark after the last one is finished
+        if (job.block < 0 && !spawned)
+            m_cancelled.remove(job.id);
+    }
+
+    locker.unlock();
+    if (engines.vertical)
+        engines.vertical->End();
+    api->End();
+}
+
+bool ZOCRService::processPage(Engines *engines, const Job &job, const ZOCRPreprocessor::Options &options)
+{
+    Q_EMIT started(job.id,job.queued.nsecsElapsed());
+
+    ZOCRPreprocessor::Result prep = ZOCRPreprocessor::process(job.image,options);
+    QElapsedTimer timer;
+    timer.start();
+
+    QString cacheContext;
+    ZOCRCache* cache = resultCache(&cacheContext);
+    QString cachedText;
+    if ((cache != nullptr) && cache->lookup(prep.image,cacheContext,cachedText)) {
+        prep.timings.append(qMakePair(QSL("cache hit"),timer.nsecsElapsed()));
+        Q_EMIT timings(job.id,prep.timingsReport());
+        Q_EMIT recognized(job.id,cachedText);
+        return false;
+    }
+    timer.restart();
+
+    // page layout analysis runs once, blocks are recognized separately with proper mode
+    QVector<Block> blocks;
+    PIX* pix = Image2PIX(prep.image);
+    if (pix != nullptr) {
+        engines->horizontal->SetPageSegMode(tesseract::PSM_AUTO);
+        engines->horizontal->SetImage(pix);
+        blocks = analyseLayout(engines->horizontal,prep.image.rect());
+        engines->horizontal->Clear();
+        pixDestroy(&pix);
+    }
+    prep.timings.append(qMakePair(QSL("layout"),timer.nsecsElapsed()));
+
+    if (blocks.count() <= 1) {
+        QImage image = prep.image;
+        tesseract::PageSegMode mode = tesseract::PSM_AUTO;
+        tesseract::TessBaseAPI* api = engines->horizontal;
+        if (!blocks.isEmpty()) {
+            image = prep.image.copy(blocks.first().rect);
+            if (blocks.first().vertical) {
+                mode = tesseract::PSM_SINGLE_BLOCK_VERT_TEXT;
+                api = verticalEngine(engines);
+            } else {
+                mode = tesseract::PSM_SINGLE_BLOCK;
+            }
+        }
+
+        timer.restart();
+        RecognizeStatus status = RecognizeStatus::Done;
+        const QString text = recognizeImage(api,job.id,image,mode,&status);
+        if (status == RecognizeStatus::Done) {
+            if (cache != nullptr)
+                cache->insert(prep.image,cacheContext,text);
+            prep.timings.append(qMakePair(QSL("ocr"),timer.nsecsElapsed()));
+            Q_EMIT timings(job.id,prep.timingsReport());
+            Q_EMIT recognized(job.id,text);
+        } else if (status == RecognizeStatus::Failed && !isCancelled(job.id)) {
+            Q_EMIT failed(job.id,tr("Tesseract recognition failed"));
+        }
+        return false;
+    }
+
+    sortInReadingOrder(blocks);
+
+    auto page = QSharedPointer<Page>::create();
+    page->texts.reserve(blocks.count());
+    for (int i=0; i<blocks.count(); i++)
+        page->texts.append(QString());
+    page->remaining = blocks.count();
+    page->timings = prep.timings;
+    page->image = prep.image;
+    page->timer.start();
+
+    // blocks go to the head of queue, so idle engines finish current page before next one
+    QMutexLocker locker(&m_mutex);
+    if (m_terminate || job.id <= m_cancelledBefore || m_cancelled.contains(job.id))
+        return false;
+
+    for (int i=0; i<blocks.count(); i++) {
+        Job blockJob;
+        blockJob.id = job.id;
+        blockJob.image = prep.image.copy(blocks.at(i).rect);
+        blockJob.block = i;
+        blockJob.vertical = blocks.at(i).vertical;
+        blockJob.page = page;
+        m_queue.insert(i,blockJob);
+    }
+    m_wakeup.wakeAll();
+    return true;
+}
+
+void ZOCRService::processBlock(Engines *engines, const Job &job)
+{
+    QString text;
+    RecognizeStatus status = RecognizeStatus::Cancelled;
+    if (!isCancelled(job.id)) {
+        if (job.vertical) {
+            text = recognizeImage(verticalEngine(engines),job.id,job.image,
+                                  tesseract::PSM_SINGLE_BLOCK_VERT_TEXT,&status);
+        } else {
+            text = recognizeImage(engines->horizontal,job.id,job.image,
+                                  tesseract::PSM_SINGLE_BLOCK,&status);
+        }
+    }
+    finishBlock(job,text,(status == RecognizeStatus::Failed));
+}
+
+void ZOCRService::finishBlock(const Job &job, const QString &text, bool blockFailed)
+{
+    QString result;
+    QString report;
+    bool pageFailed = false;
+    {
+        QMutexLocker locker(&job.page->mutex);
+        job.page->texts[job.block] = text;
+        if (blockFailed)
+            job.page->failed = true;
+        job.page->remaining--;
+        if (job.page->remaining > 0)
+            return;
+
+        pageFailed = job.page->failed;
+
+        QStringList texts = job.page->texts;
+        texts.removeAll(QString());
+        result = texts.join(QChar(u' '));
+        job.page->timings.append(qMakePair(QSL("ocr %1 blocks").arg(job.page->texts.count()),
+                                           job.page->timer.nsecsElapsed()));
+        ZOCRPreprocessor::Result stats;
+        stats.timings = job.page->timings;
+        report = stats.timingsReport();
+    }
+
+    const bool cancelled = isCancelled(job.id);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_cancelled.remove(job.id);
+    }
+    if (cancelled)
+        return;
+
+    // partial text of a page with failed block is not cached and not reported
+    if (pageFailed) {
+        Q_EMIT failed(job.id,tr("Tesseract recognition failed"));
+        return;
+    }
+
+    QString cacheContext;
+    ZOCRCache* cache = resultCache(&cacheContext);
+    if (cache != nullptr)
+        cache->insert(job.page->image,cacheContext,result);
+
+    Q_EMIT timings(job.id,report);
+    Q_EMIT recognized(job.id,result);
+}
+
+tesseract::TessBaseAPI *ZOCRService::verticalEngine(Engines *engines)
+{
+    // second engine is created on first vertical block only
+    if (!engines->verticalInitialized) {
+        engines->verticalInitialized = true;
+
+        QByteArray datapath;
+        QByteArray language;
+        {
+            QMutexLocker locker(&m_mutex);
+            datapath = m_datapath.toUtf8();
+            language = m_verticalLanguage.toUtf8();
+        }
+
+        if (!language.isEmpty()) {
+            auto api = std::make_unique<tesseract::TessBaseAPI>();
+            if (api->Init(datapath.constData(),language.constData()) == 0) {
+                engines->vertical = std::move(api);
+            } else {
+                qWarning() << "Could not initialize Tesseract vertical text model" << language;
+            }
+        }
+    }
+
+    if (engines->vertical)
+        return engines->vertical.get();
+
+    return engines->horizontal;
+}
+
+QString ZOCRService::recognizeImage(tesseract::TessBaseAPI *api, quint64 jobId, const QImage &image,
+                                    tesseract::PageSegMode mode, RecognizeStatus *status)
+{
+    *status = RecognizeStatus::Done;
+
+    PIX* pix = Image2PIX(image);
+    if (pix == nullptr) {
+        *status = RecognizeStatus::Failed;
+        return QString();
+    }
+    api->SetPageSegMode(mode);
+    api->SetImage(pix);
+
+#if TESSERACT_MAJOR_VERSION>=4
+    ZOCRCancelState state;
+    state.check = [this,jobId]{ return isCancelled(jobId); };
+
+    ETEXT_DESC monitor;
+    monitor.cancel = &ocrCancelFunc;
+    monitor.cancel_this = &state;
+    const bool error = (api->Recognize(&monitor) != 0);
+    if (error || isCancelled(jobId)) {
+        // cancel callback also aborts Recognize with error code
+        *status = isCancelled(jobId) ? RecognizeStatus::Cancelled : RecognizeStatus::Failed;
+        api->Clear();
+        pixDestroy(&pix);
+        return QString();
+    }
+#else
+    Q_UNUSED(jobId)
+#endif
+
+    char* rtext = api->GetUTF8Text();
+    QString s = QString::fromUtf8(rtext);
+    delete[] rtext;
+
+    api->Clear();
+    pixDestroy(&pix);
+
+    return postprocessText(s);
+}
+
+QVector<ZOCRService::Block> ZOCRService::analyseLayout(tesseract::TessBaseAPI *api, const QRect &imageRect)
+{
+    QVector<Block> res;
+
+    std::unique_ptr<tesseract::PageIterator> it(api->AnalyseLayout());
+    if (!it)
+        return res;
+
+    do {
+        if (!PTIsTextType(it->BlockType()))
+            continue;
+
+        int left = 0;
+        int top = 0;
+        int right = 0;
+        int bottom = 0;
+        if (!it->BoundingBox(tesseract::RIL_BLOCK,&left,&top,&right,&bottom))
+            continue;
+
+        tesseract::Orientation orientation = tesseract::ORIENTATION_PAGE_UP;
+        tesseract::WritingDirection direction = tesseract::WRITING_DIRECTION_LEFT_TO_RIGHT;
+        tesseract::TextlineOrder order = tesseract::TEXTLINE_ORDER_TOP_TO_BOTTOM;
+        float deskew = 0.0F;
+        it->Orientation(&orientation,&direction,&order,&deskew);
+
+        Block block;
+        block.rect = QRect(QPoint(left,top),QPoint(right-1,bottom-1))
+                     .adjusted(-CDefaults::ocrBlockMargin,-CDefaults::ocrBlockMargin,
+                               CDefaults::ocrBlockMargin,CDefaults::ocrBlockMargin)
+                     .intersected(imageRect);
+        block.vertical = (direction == tesseract::WRITING_DIRECTION_TOP_TO_BOTTOM ||
+                          it->BlockType() == ocrVerticalTextBlock);
+        if (block.rect.width() >= CDefaults::ocrMinBlockSize &&
+                block.rect.height() >= CDefaults::ocrMinBlockSize)
+            res.append(block);
+    } while (it->Next(tesseract::RIL_BLOCK));
+
+    return res;
+}
+
+void ZOCRService::sortInReadingOrder(QVector<Block> &blocks)
+{
+    // group blocks into horizontal bands by vertical overlap, bands are read top to bottom,
+    // inside band mostly vertical blocks are read right to left (manga), horizontal - left to right
+    std::sort(blocks.begin(),blocks.end(),[](const Block &a, const Block &b){
+        return a.rect.top() < b.rect.top();
+    });
+
+    QVector<Block> res;
+    res.reserve(blocks.count());
+    int bandStart = 0;
+    while (bandStart < blocks.count()) {
+        int bandEnd = bandStart + 1;
+        int bandBottom = blocks.at(bandStart).rect.bottom();
+        while (bandEnd < blocks.count() && blocks.at(bandEnd).rect.top() <= bandBottom) {
+            bandBottom = qMax(bandBottom,blocks.at(bandEnd).rect.bottom());
+            bandEnd++;
+        }
+
+        const auto first = blocks.begin() + bandStart;
+        const auto last = blocks.begin() + bandEnd;
+        const auto verticalCount = std::count_if(first,last,[](const Block &b){
+            return b.vertical;
+        });
+        const bool rightToLeft = (verticalCount * 2 >= (bandEnd - bandStart));
+        std::sort(first,last,[rightToLeft](const Block &a, const Block &b){
+            if (rightToLeft)
+                return a.rect.right() > b.rect.right();
+            return a.rect.left() < b.rect.left();
+        });
+
+        for (auto bit = first; bit != last; ++bit)
+            res.append(*bit);
+        bandStart = bandEnd;
+    }
+
+    blocks = res;
+}
+
+QString ZOCRService::postprocessText(const QString &text)
+{
+    // vertical blocks are already recognized column by column, only line breaks are removed
+    QString res;
+    const QStringList sl = text.split('\n',Qt::SkipEmptyParts);
+    if (!sl.isEmpty()) {
+        res = sl.join(QChar(' '));
+        const QRegularExpression newlineRx(QSL("[\r\n]+"));
+        res.replace(newlineRx,QSL(" "));
+    }
+    return res.trimmed();
+}
+
+PIX* ZOCRService::Image2PIX(const QImage &qImage)
+{
+    // Tesseract binarizes input anyway, so 8 bpp grayscale PIX is filled directly in one pass
+    QImage img = qImage;
+    switch (img.format()) {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+        case QImage::Format_Grayscale8:
+            break;
+        default:
+            img = img.convertToFormat(QImage::Format_RGB32);
+    }
+
+    const int width = img.width();
+    const int height = img.height();
+    const bool gray = (img.format() == QImage::Format_Grayscale8);
+
+    PIX* pix = pixCreateNoInit(width, height, 8);
+    if (pix == nullptr)
+        return nullptr;
+
+    l_uint32 *data = pixGetData(pix);
+    const int wpl = pixGetWpl(pix);
+    QVector<quint8> row(gray ? 0 : width);
+
+    for (int y = 0; y < height; y++) {
+        l_uint32 *line = data + y * wpl; // NOLINT
+        if (gray) {
+            ZImageKernels::grayToPixWords(img.constScanLine(y),line,width);
+        } else {
+            ZImageKernels::rgb32ToGray(reinterpret_cast<const quint32 *>(img.constScanLine(y)),row.data(),width);
+            ZImageKernels::grayToPixWords(row.constData(),line,width);
+        }
+    }
+
+    return pix;
+}
+
+#endif // WITH_OCR
@@ -0,0 +1,126 @@
+#ifndef OCRSERVICE_H
+#define OCRSERVICE_H
+
+#ifdef WITH_OCR
+
+#include <memory>
+
+#include <QObject>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <QSet>
+#include <QRect>
+#include <QVector>
+#include <QStringList>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+
+#include <tesseract/baseapi.h>
+#include <leptonica/allheaders.h>
+
+#include "ocrpreprocessor.h"
+#include "ocrcache.h"
+
+class ZOCRService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ZOCRService(QObject *parent = nullptr);
+    ~ZOCRService() override;
+
+    void start(int engines, const QString &datapath, const QString &language);
+    void stop();
+    bool isReady() const;
+
+    quint64 recognize(const QImage &image);
+    void cancel(quint64 jobId);
+    void cancelAll();
+    int pendingJobs() const;
+    void setPreprocessOptions(const ZOCRPreprocessor::Options &options);
+    void setResultCache(ZOCRCache *cache);
+
+    static QString postprocessText(const QString &text);
+
+Q_SIGNALS:
+    void started(quint64 jobId, qint64 queueWaitNS);
+    void recognized(quint64 jobId, const QString &text);
+    void failed(quint64 jobId, const QString &error);
+    void timings(quint64 jobId, const QString &report);
+
+private:
+    class Block {
+    public:
+        QRect rect;
+        bool vertical { false };
+    };
+
+    class Page {
+    public:
+        QMutex mutex;
+        QStringList texts;
+        int remaining { 0 };
+        QVector<QPair<QString,qint64> > timings;
+        QElapsedTimer timer;
+        QImage image;
+        bool failed { false };
+    };
+
+    class Job {
+    public:
+        quint64 id { 0 };
+        QImage image;
+        int block { -1 }; // -1 - whole page, layout analysis pending
+        bool vertical { false };
+        QSharedPointer<Page> page;
+        QElapsedTimer queued;
+    };
+
+    enum class RecognizeStatus {
+        Done,
+        Cancelled,
+        Failed
+    };
+
+    class Engines {
+    public:
+        tesseract::TessBaseAPI* horizontal { nullptr };
+        std::unique_ptr<tesseract::TessBaseAPI> vertical;
+        bool verticalInitialized { false };
+    };
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wakeup;
+    QList<Job> m_queue;
+    QSet<quint64> m_cancelled;
+    QList<QThread*> m_threads;
+    QString m_datapath;
+    QString m_language;
+    QString m_verticalLanguage;
+    ZOCRPreprocessor::Options m_preprocess;
+    ZOCRCache* m_cache { nullptr };
+    quint64 m_nextJobId { 0 };
+    quint64 m_cancelledBefore { 0 };
+    bool m_terminate { false };
+
+    void workerLoop();
+    bool isCancelled(quint64 jobId) const;
+    bool processPage(Engines *engines, const Job &job, const ZOCRPreprocessor::Options &options);
+    void processBlock(Engines *engines, const Job &job);
+    void finishBlock(const Job &job, const QString &text, bool blockFailed);
+    tesseract::TessBaseAPI* verticalEngine(Engines *engines);
+    ZOCRCache* resultCache(QString *context) const;
+    QString recognizeImage(tesseract::TessBaseAPI *api, quint64 jobId, const QImage &image,
+                           tesseract::PageSegMode mode, RecognizeStatus *status);
+    static QVector<Block> analyseLayout(tesseract::TessBaseAPI *api, const QRect &imageRect);
+    static void sortInReadingOrder(QVector<Block> &blocks);
+    static PIX* Image2PIX(const QImage &qImage);
+
+    Q_DISABLE_COPY(ZOCRService)
+};
+
+#endif // WITH_OCR
+
+#endif // OCRSERVICE_H
@@ -1,4 +1,4 @@
-QT += core gui widgets dbus xml
+QT += core gui widgets dbus xml concurrent network
 
 TEMPLATE = app
 
@@ -9,22 +9,52 @@ DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x050F00
 
 SOURCES += main.cpp\
     mainwindow.cpp\
+    articlecache.cpp\
+    articleflights.cpp\
+    articleprefetcher.cpp\
+    batchlookup.cpp\
+    batchocr.cpp\
     kdictionary.cpp\
     kanjimodel.cpp\
     settingsdlg.cpp\
     global.cpp\
+    imagekernels.cpp\
     dbusdict.cpp\
+    dictworkerpool.cpp\
+    dictquery.cpp\
+    localserver.cpp\
+    ocrbenchmark.cpp\
+    ocrcache.cpp\
+    ocrpreprocessor.cpp\
+    ocrservice.cpp\
     regiongrabber.cpp\
+    regionwatcher.cpp\
+    wordprefixindex.cpp\
     xcbtools.cpp
 
-HEADERS += dbusdict.h \
+HEADERS += articlecache.h \
+    articleflights.h \
+    articleprefetcher.h \
+    batchlookup.h \
+    batchocr.h \
+    dbusdict.h \
+    dictworkerpool.h \
+    dictquery.h \
     global.h \
+    imagekernels.h \
     kanjimodel.h \
     kdictionary.h \
+    localserver.h \
     mainwindow.h \
+    ocrbenchmark.h \
+    ocrcache.h \
+    ocrpreprocessor.h \
+    ocrservice.h \
     qsl.h \
     regiongrabber.h \
+    regionwatcher.h \
     settingsdlg.h \
+    wordprefixindex.h \
     xcbtools.h
 
 FORMS += mainwindow.ui\
@@ -46,7 +76,7 @@ packagesExist(tesseract) {
 use_ocr {
     DEFINES += WITH_OCR=1
     QMAKE_CXXFLAGS += -Wno-ignored-qualifiers
-    PKGCONFIG += xcb xcb-xfixes xcb-image
+    PKGCONFIG += xcb xcb-xfixes xcb-image xcb-shm xcb-damage
     PKGCONFIG += tesseract lept
 }
 
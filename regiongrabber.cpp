@@ -30,6 +30,9 @@
 #include <QApplication>
 #include <QToolTip>
 #include <QTimer>
+#include <QScreen>
+#include <QCursor>
+#include <QFontMetrics>
 
 #include "xcbtools.h"
 
@@ -55,9 +58,42 @@ ZRegionGrabber::~ZRegionGrabber() = default;
 
 void ZRegionGrabber::init()
 {
-    pixmap = ZXCBTools::getWindowPixmap( ZXCBTools::appRootWindow(), blendPointer );
-    resize( pixmap.size() );
-    move( 0, 0 );
+    // grab only the monitor with mouse pointer, selections are kept in global coordinates
+    QRect screenRect;
+    QScreen* screen = QGuiApplication::screenAt( QCursor::pos() );
+    if ( screen != nullptr ) {
+        screenRect = screen->geometry();
+        screenScale = screen->devicePixelRatio();
+    }
+
+    if ( screenRect.isEmpty() ) {
+        screenScale = 1.0;
+        pixmap = ZXCBTools::getWindowPixmap( ZXCBTools::appRootWindow(), blendPointer );
+        screenRect = QRect( QPoint( 0, 0 ), pixmap.size() );
+    } else {
+        // Qt keeps screen origin in native pixels and scales only its size, X11 works in native pixels
+        const QRect nativeRect( screenRect.topLeft(), screenRect.size() * screenScale );
+        pixmap = ZXCBTools::getScreenAreaPixmap( nativeRect, blendPointer );
+    }
+    pixmap.setDevicePixelRatio( screenScale );
+
+    // window tree is fetched once, snapping only queries spatial index
+    windowSnapshot = ZXCBTools::windowSnapshot();
+
+    // overlay dimming is painted once, repaints only blit parts of both pixmaps
+    const int alphaLevel = 160;
+    dimmedPixmap = pixmap;
+    {
+        QPainter dimmer( &dimmedPixmap );
+        dimmer.fillRect( dimmedPixmap.rect(), QColor( 0, 0, 0, alphaLevel ) );
+    }
+
+    screenOrigin = screenRect.topLeft();
+    if ( !selection.isNull() )
+        selection = fromNative( selection );
+
+    resize( screenRect.size() );
+    move( screenOrigin );
     setCursor( Qt::CrossCursor );
     show();
     grabMouse();
@@ -84,7 +120,6 @@ static void drawRect( QPainter *painter, const QRect &r, const QColor &outline,
 
 void ZRegionGrabber::paintEvent( QPaintEvent* e )
 {
-    Q_UNUSED( e );
     const int alphaLevel = 160;
 
     if ( grabbing ) // grabWindow() should just get the background
@@ -97,34 +132,34 @@ void ZRegionGrabber::paintEvent( QPaintEvent* e )
 
     QColor handleColor = pal.color( QPalette::Active, QPalette::Highlight );
     handleColor.setAlpha( alphaLevel );
-    QColor overlayColor( 0, 0, 0, alphaLevel );
     const QColor& textColor = pal.color( QPalette::Active, QPalette::Text );
     const QColor& textBackgroundColor = pal.color( QPalette::Active, QPalette::Base );
-    painter.drawPixmap(0, 0, pixmap);
     painter.setFont(font);
 
-    QRect r = selection;
+    // only invalidated rectangles are copied, selection itself shows undimmed screenshot
+    const QRect r = selection;
+    for (const QRect &dirty : e->region()) {
+        if ( selection.isNull() ) {
+            painter.drawPixmap( QRectF( dirty ), pixmap, devicePixels( dirty ) );
+            continue;
+        }
+        const QRegion dimmed = QRegion( dirty ).subtracted( r );
+        for (const QRect &d : dimmed)
+            painter.drawPixmap( QRectF( d ), dimmedPixmap, devicePixels( d ) );
+        const QRect bright = dirty.intersected( r );
+        if ( !bright.isEmpty() )
+            painter.drawPixmap( QRectF( bright ), pixmap, devicePixels( bright ) );
+    }
+
     if ( !selection.isNull() )
-    {
-        QRegion grey( rect() );
-        grey = grey.subtracted( r );
-        painter.setClipRegion( grey );
-        painter.setPen( Qt::NoPen );
-        painter.setBrush( overlayColor );
-        painter.drawRect( rect() );
-        painter.setClipRect( rect() );
         drawRect( &painter, r, handleColor );
-    }
 
-    if ( showHelp )
+    if ( showHelp && e->region().intersects( helpTextRect ) )
     {
         painter.setPen( textColor );
         painter.setBrush( textBackgroundColor );
-        QString helpText = tr( "Select a region using the mouse. To take the snapshot, press the Enter key or double click. Press Esc to quit." );
-        helpTextRect = painter.boundingRect( rect().adjusted( 2, 2, -2, -2 ), Qt::TextWordWrap, helpText );
-        helpTextRect.adjust( -2, -2, 4, 2 );
         drawRect( &painter, helpTextRect, textColor, textBackgroundColor );
-        painter.drawText( helpTextRect.adjusted( 3, 3, -3, -3 ), helpText );
+        painter.drawText( helpTextRect.adjusted( 3, 3, -3, -3 ), Qt::TextWordWrap, helpText() );
     }
 
     if ( selection.isNull() )
@@ -135,10 +170,47 @@ void ZRegionGrabber::paintEvent( QPaintEvent* e )
     // The grabbed region is everything which is covered by the drawn
     // rectangles (border included). This means that there is no 0px
     // selection, since a 0px wide rectangle will always be drawn as a line.
-    QString txt = QSL( "%1x%2" ).arg( selection.width() )
-                  .arg( selection.height() );
-    QRect textRect = painter.boundingRect( rect(), Qt::AlignLeft, txt );
-    QRect boundingRect = textRect.adjusted( -4, 0, 0, 0);
+    QRect textRect;
+    QRect boundingRect;
+    sizeLabelRects( r, textRect, boundingRect );
+    if ( e->region().intersects( boundingRect ) ) {
+        painter.setPen( textColor );
+        drawRect( &painter, boundingRect, textColor, textBackgroundColor );
+        painter.drawText( textRect, sizeLabelText( r ) );
+    }
+
+    if ( ( r.height() > handleSize*2 && r.width() > handleSize*2 )
+         || !mouseDown )
+    {
+        const int handleAlpha = 60;
+        updateHandles();
+        painter.setPen( Qt::NoPen );
+        painter.setBrush( handleColor );
+        painter.setClipRegion( handleMask( StrokeMask ).intersected( e->region() ) );
+        painter.drawRect( rect() );
+        handleColor.setAlpha( handleAlpha );
+        painter.setBrush( handleColor );
+        painter.setClipRegion( handleMask( FillMask ).intersected( e->region() ) );
+        painter.drawRect( rect() );
+    }
+}
+
+QString ZRegionGrabber::helpText() const
+{
+    return tr( "Select a region using the mouse. Hold Shift to snap selection to window under the pointer. "
+               "To take the snapshot, press the Enter key or double click. Press Esc to quit." );
+}
+
+QString ZRegionGrabber::sizeLabelText( const QRect &r ) const
+{
+    return QSL( "%1x%2" ).arg( r.width() ).arg( r.height() );
+}
+
+void ZRegionGrabber::sizeLabelRects( const QRect &r, QRect &textRect, QRect &boundingRect ) const
+{
+    const QFontMetrics fm( QToolTip::font() );
+    textRect = fm.boundingRect( rect(), Qt::AlignLeft, sizeLabelText( r ) );
+    boundingRect = textRect.adjusted( -4, 0, 0, 0);
 
     if ( textRect.width() < r.width() - 2*handleSize &&
          textRect.height() < r.height() - 2*handleSize &&
@@ -170,29 +242,42 @@ void ZRegionGrabber::paintEvent( QPaintEvent* e )
         textRect.moveBottomLeft( QPoint( r.right() + 5, r.bottom() ) );
     }
     // if the above didn't catch it, you are running on a very tiny screen...
-    drawRect( &painter, boundingRect, textColor, textBackgroundColor );
+}
 
-    painter.drawText( textRect, txt );
+QRegion ZRegionGrabber::selectionArea( const QRect &r ) const
+{
+    if ( r.isNull() )
+        return QRegion();
 
-    if ( ( r.height() > handleSize*2 && r.width() > handleSize*2 )
-         || !mouseDown )
-    {
-        const int handleAlpha = 60;
-        updateHandles();
-        painter.setPen( Qt::NoPen );
-        painter.setBrush( handleColor );
-        painter.setClipRegion( handleMask( StrokeMask ) );
-        painter.drawRect( rect() );
-        handleColor.setAlpha( handleAlpha );
-        painter.setBrush( handleColor );
-        painter.setClipRegion( handleMask( FillMask ) );
-        painter.drawRect( rect() );
+    QRect textRect;
+    QRect boundingRect;
+    sizeLabelRects( r, textRect, boundingRect );
+    return QRegion( r.adjusted( -1, -1, 1, 1 ) ) + boundingRect.adjusted( -1, -1, 1, 1 );
+}
+
+void ZRegionGrabber::selectionUpdated( const QRect &previous )
+{
+    // dimming of whole screen depends on selection presence
+    if ( previous.isNull() != selection.isNull() ) {
+        update();
+        return;
     }
+
+    // old and new selection frames, handles and size labels are repainted
+    update( selectionArea( previous ) + selectionArea( selection ) );
+}
+
+void ZRegionGrabber::updateHelpText()
+{
+    const QFontMetrics fm( QToolTip::font() );
+    helpTextRect = fm.boundingRect( rect().adjusted( 2, 2, -2, -2 ), Qt::TextWordWrap, helpText() );
+    helpTextRect.adjust( -2, -2, 4, 2 );
 }
 
 void ZRegionGrabber::resizeEvent( QResizeEvent* e )
 {
     Q_UNUSED( e );
+    updateHelpText();
     if ( selection.isNull() )
         return;
     QRect r = selection;
@@ -207,7 +292,12 @@ void ZRegionGrabber::resizeEvent( QResizeEvent* e )
 
 void ZRegionGrabber::mousePressEvent( QMouseEvent* e )
 {
-    showHelp = !helpTextRect.contains( e->pos() );
+    const QRect previous = selection;
+    const bool shouldShowHelp = !helpTextRect.contains( e->pos() );
+    if (shouldShowHelp != showHelp) {
+        showHelp = shouldShowHelp;
+        update( helpTextRect );
+    }
     if ( e->button() == Qt::LeftButton )
     {
         mouseDown = true;
@@ -229,15 +319,16 @@ void ZRegionGrabber::mousePressEvent( QMouseEvent* e )
         selection = QRect();
         setCursor( Qt::CrossCursor );
     }
-    update();
+    selectionUpdated( previous );
 }
 
 void ZRegionGrabber::mouseMoveEvent( QMouseEvent* e )
 {
-    bool shouldShowHelp = !helpTextRect.contains( e->pos() );
+    const QRect previous = selection;
+    const bool shouldShowHelp = !helpTextRect.contains( e->pos() );
     if (shouldShowHelp != showHelp) {
         showHelp = shouldShowHelp;
-        update();
+        update( helpTextRect );
     }
 
     if ( mouseDown )
@@ -289,10 +380,23 @@ void ZRegionGrabber::mouseMoveEvent( QMouseEvent* e )
             r.setBottomRight( limitPointToRect( r.bottomRight(), rect() ) );
             selection = normalizeSelection(r);
         }
-        update();
+        if ( selection != previous )
+            selectionUpdated( previous );
     }
     else
     {
+        if ( e->modifiers().testFlag( Qt::ShiftModifier ) && !windowSnapshot.isEmpty() )
+        {
+            const QRect w = windowSnapshot.windowAt( screenOrigin + e->pos() * screenScale );
+            if ( !w.isNull() ) {
+                const QRect r = fromNative( w ).intersected( rect() );
+                if ( r != selection && r.width() > 1 && r.height() > 1 ) {
+                    selection = r;
+                    selectionUpdated( previous );
+                }
+            }
+        }
+
         if ( selection.isNull() )
             return;
         bool found = false;
@@ -333,7 +437,7 @@ void ZRegionGrabber::mouseReleaseEvent( QMouseEvent* e )
     newSelection = false;
     if ( mouseOverHandle == nullptr && selection.contains( e->pos() ) )
         setCursor( Qt::OpenHandCursor );
-    update();
+    selectionUpdated( selection );
 }
 
 void ZRegionGrabber::mouseDoubleClickEvent( QMouseEvent* event )
@@ -347,7 +451,7 @@ void ZRegionGrabber::keyPressEvent( QKeyEvent* e )
     QRect r = selection;
     if ( e->key() == Qt::Key_Escape )
     {
-        Q_EMIT regionUpdated( r );
+        Q_EMIT regionUpdated( r.isNull() ? r : toNative( r ) );
         Q_EMIT regionGrabbed( QPixmap() );
     }
     else if ( e->key() == Qt::Key_Enter || e->key() == Qt::Key_Return )
@@ -366,11 +470,31 @@ void ZRegionGrabber::grabRect()
     if ( !r.isNull() && r.isValid() )
     {
 	grabbing = true;
-        Q_EMIT regionUpdated( r );
-        Q_EMIT regionGrabbed( pixmap.copy(r) );
+        Q_EMIT regionUpdated( toNative( r ) );
+        QPixmap grabbed = pixmap.copy( devicePixels( r ).toAlignedRect() );
+        grabbed.setDevicePixelRatio( 1.0 );
+        Q_EMIT regionGrabbed( grabbed );
     }
 }
 
+QRectF ZRegionGrabber::devicePixels( const QRect &r ) const
+{
+    return QRectF( r.x() * screenScale, r.y() * screenScale,
+                   r.width() * screenScale, r.height() * screenScale );
+}
+
+QRect ZRegionGrabber::toNative( const QRect &r ) const
+{
+    return devicePixels( r ).toAlignedRect().translated( screenOrigin );
+}
+
+QRect ZRegionGrabber::fromNative( const QRect &r ) const
+{
+    const QRect local = r.translated( -screenOrigin );
+    return QRectF( local.x() / screenScale, local.y() / screenScale,
+                   local.width() / screenScale, local.height() / screenScale ).toAlignedRect();
+}
+
 void ZRegionGrabber::updateHandles()
 {
     QRect r = selection;
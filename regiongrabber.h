@@ -27,6 +27,8 @@
 #include <QVector>
 #include <QRect>
 
+#include "xcbtools.h"
+
 class QPaintEvent;
 class QResizeEvent;
 class QMouseEvent;
@@ -62,7 +64,16 @@ private:
     QRegion handleMask( MaskType type ) const;
     QPoint limitPointToRect( const QPoint &p, const QRect &r ) const;
     QRect normalizeSelection( const QRect &s ) const;
+    QRectF devicePixels( const QRect &r ) const;
+    QRect toNative( const QRect &r ) const;
+    QRect fromNative( const QRect &r ) const;
     void grabRect();
+    QString helpText() const;
+    QString sizeLabelText( const QRect &r ) const;
+    void sizeLabelRects( const QRect &r, QRect &textRect, QRect &boundingRect ) const;
+    QRegion selectionArea( const QRect &r ) const;
+    void selectionUpdated( const QRect &previous );
+    void updateHelpText();
 
     static bool blendPointer;
     QRect selection;
@@ -85,6 +96,10 @@ private:
 
     QVector<QRect*> handles;
     QPixmap pixmap;
+    QPixmap dimmedPixmap;
+    QPoint screenOrigin;
+    qreal screenScale { 1.0 };
+    ZWindowSnapshot windowSnapshot;
 };
 
 #endif // OCR
@@ -0,0 +1,208 @@
+#include <QSocketNotifier>
+#include <QScopedPointer>
+#include <cstdlib>
+#include <QDebug>
+#include "regionwatcher.h"
+#include "xcbtools.h"
+#include "imagekernels.h"
+#include "ocrpreprocessor.h"
+
+#ifdef WITH_OCR
+
+#include <xcb/xfixes.h>
+
+namespace CDefaults {
+const int watchSettleDelay = 150;
+const quint8 watchPixelTolerance = 24;
+const int watchChangedPixelsPermille = 2;
+}
+
+ZRegionWatcher::ZRegionWatcher(QObject *parent)
+    : QObject(parent)
+{
+    // animations and scrolling text produce bursts of damage, capture after screen settles
+    m_settleTimer.setSingleShot(true);
+    m_settleTimer.setInterval(CDefaults::watchSettleDelay);
+    connect(&m_settleTimer,&QTimer::timeout,this,&ZRegionWatcher::captureRegion);
+}
+
+ZRegionWatcher::~ZRegionWatcher()
+{
+    stop();
+}
+
+bool ZRegionWatcher::start(const QRect &region)
+{
+    stop();
+
+    if (!region.isValid())
+        return false;
+
+    // own connection, damage events are dispatched from Qt event loop via socket notifier
+    m_connection = xcb_connect(nullptr, nullptr);
+    if (xcb_connection_has_error(m_connection) > 0) {
+        qWarning() << "Region watch: unable to connect to X server";
+        stop();
+        return false;
+    }
+
+    const xcb_query_extension_reply_t *ext = xcb_get_extension_data(m_connection, &xcb_damage_id);
+    if ((ext == nullptr) || (ext->present == 0)) {
+        qWarning() << "Region watch: DAMAGE extension is not available";
+        stop();
+        return false;
+    }
+    m_damageEventBase = ext->first_event;
+
+    // DAMAGE requires XFIXES for region handling in DamageSubtract
+    const xcb_query_extension_reply_t *xfixesExt = xcb_get_extension_data(m_connection, &xcb_xfixes_id);
+    if ((xfixesExt != nullptr) && (xfixesExt->present != 0)) {
+        xcb_xfixes_query_version_cookie_t fc = xcb_xfixes_query_version(m_connection, XCB_XFIXES_MAJOR_VERSION,
+                                                                        XCB_XFIXES_MINOR_VERSION);
+        free(xcb_xfixes_query_version_reply(m_connection, fc, nullptr)); // NOLINT
+    }
+
+    xcb_damage_query_version_cookie_t vc = xcb_damage_query_version(m_connection, XCB_DAMAGE_MAJOR_VERSION,
+                                                                    XCB_DAMAGE_MINOR_VERSION);
+    QScopedPointer<xcb_damage_query_version_reply_t,QScopedPointerPodDeleter>
+            vr(xcb_damage_query_version_reply(m_connection, vc, nullptr));
+    if (vr.isNull()) {
+        qWarning() << "Region watch: unable to initialize DAMAGE extension";
+        stop();
+        return false;
+    }
+
+    const xcb_setup_t *setup = xcb_get_setup(m_connection);
+    const xcb_screen_iterator_t it = xcb_setup_roots_iterator(setup);
+    if (it.rem <= 0) {
+        stop();
+        return false;
+    }
+
+    m_damage = xcb_generate_id(m_connection);
+    xcb_void_cookie_t dc = xcb_damage_create_checked(m_connection, m_damage, it.data->root,
+                                                     XCB_DAMAGE_REPORT_LEVEL_BOUNDING_BOX);
+    QScopedPointer<xcb_generic_error_t,QScopedPointerPodDeleter> err(xcb_request_check(m_connection, dc));
+    if (err) {
+        qWarning() << "Region watch: unable to create damage object";
+        m_damage = XCB_NONE;
+        stop();
+        return false;
+    }
+
+    m_region = region;
+    m_lastFrame = QImage();
+
+    m_notifier = new QSocketNotifier(xcb_get_file_descriptor(m_connection), QSocketNotifier::Read, this);
+    connect(m_notifier,&QSocketNotifier::activated,this,&ZRegionWatcher::processEvents);
+
+    // initial text is recognized right away
+    m_settleTimer.start(0);
+    return true;
+}
+
+void ZRegionWatcher::stop()
+{
+    m_settleTimer.stop();
+
+    // stop() may run from the notifier's own activated() signal
+    if (m_notifier) {
+        m_notifier->setEnabled(false);
+        m_notifier->deleteLater();
+        m_notifier = nullptr;
+    }
+
+    if (m_connection) {
+        if (m_damage != XCB_NONE)
+            xcb_damage_destroy(m_connection, m_damage);
+        xcb_flush(m_connection);
+        xcb_disconnect(m_connection);
+    }
+
+    m_connection = nullptr;
+    m_damage = XCB_NONE;
+    m_region = QRect();
+    m_lastFrame = QImage();
+}
+
+bool ZRegionWatcher::isActive() const
+{
+    return (m_connection != nullptr && m_damage != XCB_NONE);
+}
+
+QRect ZRegionWatcher::region() const
+{
+    return m_region;
+}
+
+void ZRegionWatcher::processEvents()
+{
+    if (m_connection == nullptr)
+        return;
+
+    bool dirty = false;
+    while (true) {
+        QScopedPointer<xcb_generic_event_t,QScopedPointerPodDeleter> event(xcb_poll_for_event(m_connection));
+        if (event.isNull())
+            break;
+
+        if ((event->response_type & ~0x80U) != (m_damageEventBase + XCB_DAMAGE_NOTIFY)) // NOLINT
+            continue;
+
+        const auto *notify = reinterpret_cast<xcb_damage_notify_event_t *>(event.data());
+        const QRect area(notify->area.x + notify->geometry.x, notify->area.y + notify->geometry.y,
+                         notify->area.width, notify->area.height);
+        if (area.intersects(m_region))
+            dirty = true;
+    }
+
+    if (xcb_connection_has_error(m_connection) > 0) {
+        qWarning() << "Region watch: X connection lost";
+        stop();
+        return;
+    }
+
+    if (dirty && !m_settleTimer.isActive())
+        m_settleTimer.start();
+}
+
+void ZRegionWatcher::captureRegion()
+{
+    if (!isActive())
+        return;
+
+    // reset accumulated damage, bounding box level reports again only after subtract
+    xcb_damage_subtract(m_connection, m_damage, XCB_NONE, XCB_NONE);
+    xcb_flush(m_connection);
+
+    const QImage image = ZXCBTools::getScreenAreaPixmap(m_region, false).toImage();
+    if (image.isNull())
+        return;
+
+    const QImage gray = ZOCRPreprocessor::toGrayscale(image);
+    if (!frameChanged(gray))
+        return;
+
+    m_lastFrame = gray;
+    Q_EMIT regionChanged(image);
+}
+
+bool ZRegionWatcher::frameChanged(const QImage &gray) const
+{
+    // cursor blinking and small overlays are ignored, only noticeable change triggers OCR
+    if (m_lastFrame.isNull() || m_lastFrame.size() != gray.size())
+        return true;
+
+    const qint64 limit = static_cast<qint64>(gray.width()) * gray.height()
+                         * CDefaults::watchChangedPixelsPermille / 1000; // NOLINT
+    qint64 changed = 0;
+    for (int y = 0; y < gray.height(); y++) {
+        changed += ZImageKernels::countChanged(gray.constScanLine(y),m_lastFrame.constScanLine(y),
+                                               gray.width(),CDefaults::watchPixelTolerance);
+        if (changed > limit)
+            return true;
+    }
+    return false;
+}
+
+#endif // WITH_OCR
@@ -0,0 +1,51 @@
+#ifndef REGIONWATCHER_H
+#define REGIONWATCHER_H
+
+#ifdef WITH_OCR
+
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <QTimer>
+
+#include <xcb/xcb.h>
+#include <xcb/damage.h>
+
+class QSocketNotifier;
+
+class ZRegionWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ZRegionWatcher(QObject *parent = nullptr);
+    ~ZRegionWatcher() override;
+
+    bool start(const QRect &region);
+    void stop();
+    bool isActive() const;
+    QRect region() const;
+
+Q_SIGNALS:
+    void regionChanged(const QImage &image);
+
+private Q_SLOTS:
+    void processEvents();
+    void captureRegion();
+
+private:
+    xcb_connection_t* m_connection { nullptr };
+    xcb_damage_damage_t m_damage { XCB_NONE };
+    quint8 m_damageEventBase { 0 };
+    QSocketNotifier* m_notifier { nullptr };
+    QTimer m_settleTimer;
+    QRect m_region;
+    QImage m_lastFrame;
+
+    bool frameChanged(const QImage &gray) const;
+
+    Q_DISABLE_COPY(ZRegionWatcher)
+};
+
+#endif // WITH_OCR
+
+#endif // REGIONWATCHER_H
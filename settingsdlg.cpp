@@ -29,6 +29,11 @@ ZSettingsDialog::ZSettingsDialog(QWidget *parent) :
     ui->groupTesseract->setEnabled(false);
     ui->editOCRDatapath->setEnabled(false);
     ui->comboOCRLanguage->setEnabled(false);
+    ui->checkOCRPreprocess->setEnabled(false);
+    ui->checkOCRInvert->setEnabled(false);
+    ui->checkOCRContrast->setEnabled(false);
+    ui->checkOCRBinarize->setEnabled(false);
+    ui->comboOCRUpscale->setEnabled(false);
 #endif
 }
 
@@ -64,6 +69,13 @@ void ZSettingsDialog::loadSettings()
 #ifdef WITH_OCR
     ui->editOCRDatapath->setText(zF->ocrGetDatapath());
     updateOCRLanguages();
+
+    const ZOCRPreprocessor::Options prep = ZOCRPreprocessor::Options::fromSettings();
+    ui->checkOCRPreprocess->setChecked(prep.enabled);
+    ui->checkOCRInvert->setChecked(prep.autoInvert);
+    ui->checkOCRContrast->setChecked(prep.normalizeContrast);
+    ui->checkOCRBinarize->setChecked(prep.binarize);
+    ui->comboOCRUpscale->setCurrentIndex(qBound(0,prep.upscale,ui->comboOCRUpscale->count()-1));
 #endif
 }
 
@@ -95,6 +107,16 @@ void ZSettingsDialog::saveSettings()
     stg.setValue(QSL("datapath"), ui->editOCRDatapath->text());
     stg.endGroup();
 
+    ZOCRPreprocessor::Options prep;
+    prep.enabled = ui->checkOCRPreprocess->isChecked();
+    prep.autoInvert = ui->checkOCRInvert->isChecked();
+    prep.normalizeContrast = ui->checkOCRContrast->isChecked();
+    prep.binarize = ui->checkOCRBinarize->isChecked();
+    prep.upscale = ui->comboOCRUpscale->currentIndex();
+    prep.toSettings();
+    if (zF->ocrService)
+        zF->ocrService->setPreprocessOptions(prep);
+
     if (needRestart) {
         QMessageBox::information(this,QGuiApplication::applicationDisplayName(),
                                  tr("OCR datapath changed.\n"
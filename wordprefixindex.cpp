@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <utility>
+#include "wordprefixindex.h"
+
+void ZWordPrefixIndex::insert(const QString &prefix, int limit, quint32 generation, const QStringList &words)
+{
+    // truncated reply doesn't contain all words for longer prefixes,
+    // normalized matches from controller can't be refined locally
+    if (words.count() >= limit ||
+            !std::all_of(words.constBegin(),words.constEnd(),[&prefix](const QString &word){
+                             return word.startsWith(prefix);
+                         })) {
+        m_valid = false;
+        return;
+    }
+
+    m_words = words;
+    m_prefix = prefix;
+    m_generation = generation;
+    m_valid = true;
+
+    // sorted view over controller order, words with common prefix form one contiguous range
+    m_sorted.resize(m_words.count());
+    for (int i = 0; i < m_sorted.count(); i++)
+        m_sorted[i] = i;
+    std::sort(m_sorted.begin(),m_sorted.end(),[this](int a, int b){
+        return m_words.at(a) < m_words.at(b);
+    });
+}
+
+bool ZWordPrefixIndex::lookup(const QString &prefix, int limit, quint32 generation, QStringList &words) const
+{
+    if (!m_valid || generation != m_generation || !prefix.startsWith(m_prefix))
+        return false;
+
+    const auto first = std::lower_bound(m_sorted.constBegin(),m_sorted.constEnd(),prefix,
+                                        [this](int idx, const QString &value){
+        return m_words.at(idx) < value;
+    });
+
+    // cost depends only on matched range, not on size of the stored reply
+    QVector<int> matches;
+    for (auto it = first; it != m_sorted.constEnd() && m_words.at(*it).startsWith(prefix); ++it)
+        matches.append(*it);
+    std::sort(matches.begin(),matches.end());
+    if (matches.count() > limit)
+        matches.resize(limit);
+
+    words.clear();
+    words.reserve(matches.count());
+    for (const int idx : std::as_const(matches))
+        words.append(m_words.at(idx));
+    return true;
+}
+
+void ZWordPrefixIndex::clear()
+{
+    m_words.clear();
+    m_sorted.clear();
+    m_prefix.clear();
+    m_valid = false;
+}
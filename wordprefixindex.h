@@ -0,0 +1,28 @@
+#ifndef WORDPREFIXINDEX_H
+#define WORDPREFIXINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class ZWordPrefixIndex
+{
+public:
+    ZWordPrefixIndex() = default;
+    ~ZWordPrefixIndex() = default;
+
+    void insert(const QString &prefix, int limit, quint32 generation, const QStringList &words);
+    bool lookup(const QString &prefix, int limit, quint32 generation, QStringList &words) const;
+    void clear();
+
+private:
+    QStringList m_words;
+    QVector<int> m_sorted;
+    QString m_prefix;
+    quint32 m_generation { 0 };
+    bool m_valid { false };
+
+    Q_DISABLE_COPY(ZWordPrefixIndex)
+};
+
+#endif // WORDPREFIXINDEX_H
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <xcb/xcb.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 #include <QPointer>
 #include <QMutex>
@@ -11,8 +13,10 @@
 #include <QScreen>
 #include <QApplication>
 #include <QDebug>
+#include <QHash>
 
 #include "xcbtools.h"
+#include "imagekernels.h"
 
 static const int minSize = 8;
 
@@ -21,56 +25,129 @@ ZXCBTools::ZXCBTools(QObject *parent)
 {
     m_connection = xcb_connect(nullptr, nullptr);
     int res = xcb_connection_has_error(m_connection);
-    if (res>0)
+    if (res>0) {
         qCritical() << "Error in XCB connection " << res;
+        return;
+    }
+
+    // MIT-SHM works for local X server only, plain GetImage is used otherwise
+    const xcb_query_extension_reply_t *ext = xcb_get_extension_data(m_connection, &xcb_shm_id);
+    if ((ext != nullptr) && (ext->present != 0)) {
+        xcb_shm_query_version_cookie_t vc = xcb_shm_query_version(m_connection);
+        QScopedPointer<xcb_shm_query_version_reply_t,QScopedPointerPodDeleter>
+                vr(xcb_shm_query_version_reply(m_connection, vc, nullptr));
+        m_shmAvailable = !vr.isNull();
+    }
 }
 
 ZXCBTools::~ZXCBTools()
 {
+    releaseShmSegment();
     xcb_disconnect(m_connection);
 }
 
-xcb_connection_t *ZXCBTools::connection()
+ZXCBTools *ZXCBTools::instance()
 {
     static QPointer<ZXCBTools> inst;
     static QMutex instMutex;
 
-    instMutex.lock();
+    QMutexLocker locker(&instMutex);
 
     if (inst.isNull())
         inst = new ZXCBTools(QApplication::instance());
 
-    instMutex.unlock();
+    return inst.data();
+}
 
-    return inst->m_connection;
+xcb_connection_t *ZXCBTools::connection()
+{
+    return instance()->m_connection;
 }
 
-xcb_window_t ZXCBTools::appRootWindow()
+bool ZXCBTools::allocateShmSegment(size_t size)
 {
-    xcb_connection_t *c = connection();
-    const xcb_setup_t *setup = xcb_get_setup(c);
-    xcb_screen_iterator_t it = xcb_setup_roots_iterator(setup);
+    if (m_shmAddr && m_shmSize >= size)
+        return true;
 
-    while (it.rem>0) {
-        xcb_window_t root = it.data->root;
-        xcb_query_pointer_cookie_t pc = xcb_query_pointer(c, root);
-        QScopedPointer<xcb_query_pointer_reply_t,QScopedPointerPodDeleter>
-                pr(xcb_query_pointer_reply(c, pc, nullptr));
-        if ((pr != nullptr) && (pr->same_screen > 0))
-            return root;
+    releaseShmSegment();
 
-        xcb_screen_next(&it);
+    const int shmId = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600); // NOLINT
+    if (shmId < 0)
+        return false;
+
+    void* addr = shmat(shmId, nullptr, 0);
+    if (addr == reinterpret_cast<void *>(-1)) { // NOLINT
+        shmctl(shmId, IPC_RMID, nullptr);
+        return false;
     }
 
-    return 0;
+    const xcb_shm_seg_t seg = xcb_generate_id(m_connection);
+    xcb_void_cookie_t ac = xcb_shm_attach_checked(m_connection, seg, static_cast<quint32>(shmId), 0);
+    QScopedPointer<xcb_generic_error_t,QScopedPointerPodDeleter> err(xcb_request_check(m_connection, ac));
+
+    // segment is destroyed automatically after both sides are detached
+    shmctl(shmId, IPC_RMID, nullptr);
+
+    if (err) {
+        qWarning() << "Unable to attach MIT-SHM segment, falling back to GetImage";
+        shmdt(addr);
+        m_shmAvailable = false;
+        return false;
+    }
+
+    m_shmSeg = seg;
+    m_shmAddr = static_cast<uchar *>(addr);
+    m_shmSize = size;
+    return true;
 }
 
-QPixmap ZXCBTools::convertFromNative(xcb_image_t *xcbImage)
+void ZXCBTools::releaseShmSegment()
+{
+    if (m_shmAddr == nullptr)
+        return;
+
+    xcb_shm_detach(m_connection, m_shmSeg);
+    xcb_flush(m_connection);
+    shmdt(m_shmAddr);
+    m_shmSeg = XCB_NONE;
+    m_shmAddr = nullptr;
+    m_shmSize = 0;
+}
+
+QImage ZXCBTools::getShmImage(xcb_window_t window, int x, int y, int width, int height)
+{
+    ZXCBTools* inst = instance();
+    QMutexLocker locker(&inst->m_shmMutex);
+
+    if (!inst->m_shmAvailable || width <= 0 || height <= 0)
+        return QImage();
+
+    // Z pixmap scanlines are padded to 32 bits, 4 bytes per pixel is the upper bound
+    const size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+    if (!inst->allocateShmSegment(size))
+        return QImage();
+
+    xcb_connection_t* c = inst->m_connection;
+    xcb_shm_get_image_cookie_t ic = xcb_shm_get_image(c, window,
+                                                      static_cast<int16_t>(x), static_cast<int16_t>(y),
+                                                      static_cast<uint16_t>(width), static_cast<uint16_t>(height),
+                                                      ~0U, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                      inst->m_shmSeg, 0);
+    QScopedPointer<xcb_shm_get_image_reply_t,QScopedPointerPodDeleter>
+            ir(xcb_shm_get_image_reply(c, ic, nullptr));
+
+    if (ir.isNull() || ir->size == 0 || ir->size > size)
+        return QImage();
+
+    const int bytesPerLine = static_cast<int>(ir->size / static_cast<quint32>(height));
+    return imageFromNative(inst->m_shmAddr, width, height, bytesPerLine, ir->depth);
+}
+
+QImage ZXCBTools::imageFromNative(const uchar *data, int width, int height, int bytesPerLine, int depth)
 {
     QImage::Format format = QImage::Format_Invalid;
-    quint32 *pixels = nullptr;
 
-    switch (xcbImage->depth) {
+    switch (depth) {
     case 1:
         format = QImage::Format_MonoLSB;
         break;
@@ -80,29 +157,29 @@ QPixmap ZXCBTools::convertFromNative(xcb_image_t *xcbImage)
     case 24: // NOLINT
         format = QImage::Format_RGB32;
         break;
-    case 30: // NOLINT
+    case 30: { // NOLINT
         // Qt doesn't have a matching image format. We need to convert manually
-        pixels = reinterpret_cast<quint32 *>(xcbImage->data);
-        for (uint i = 0; i < (xcbImage->size / 4); i++) {
-            int r = (pixels[i] >> 22) & 0xff; // NOLINT
-            int g = (pixels[i] >> 12) & 0xff; // NOLINT
-            int b = (pixels[i] >>  2) & 0xff; // NOLINT
-
-            pixels[i] = qRgba(r, g, b, 0xff); // NOLINT
+        QImage image(width, height, QImage::Format_RGB32);
+        if (image.isNull())
+            return QImage();
+        for (int y = 0; y < height; y++) {
+            ZImageKernels::rgb30ToRgb32(reinterpret_cast<const quint32 *>(data + y * bytesPerLine), // NOLINT
+                                        reinterpret_cast<quint32 *>(image.scanLine(y)), width);
         }
-        // fall through, Qt format is still Format_ARGB32_Premultiplied
-        [[clang::fallthrough]];
+        return image;
+    }
     case 32: // NOLINT
         format = QImage::Format_ARGB32_Premultiplied;
         break;
     default:
-        return QPixmap(); // we don't know
+        return QImage(); // we don't know
     }
 
-    QImage image(xcbImage->data, xcbImage->width, xcbImage->height, format);
+    // deep copy, native buffer is reused or freed right after conversion
+    QImage image = QImage(data, width, height, bytesPerLine, format).copy();
 
     if (image.isNull()) {
-        return QPixmap();
+        return QImage();
     }
 
     // work around an abort in QImage::color
@@ -113,9 +190,33 @@ QPixmap ZXCBTools::convertFromNative(xcb_image_t *xcbImage)
         image.setColor(1, QColor(Qt::black).rgb());
     }
 
-    // done
+    return image;
+}
+
+xcb_window_t ZXCBTools::appRootWindow()
+{
+    xcb_connection_t *c = connection();
+    const xcb_setup_t *setup = xcb_get_setup(c);
+    xcb_screen_iterator_t it = xcb_setup_roots_iterator(setup);
+
+    while (it.rem>0) {
+        xcb_window_t root = it.data->root;
+        xcb_query_pointer_cookie_t pc = xcb_query_pointer(c, root);
+        QScopedPointer<xcb_query_pointer_reply_t,QScopedPointerPodDeleter>
+                pr(xcb_query_pointer_reply(c, pc, nullptr));
+        if ((pr != nullptr) && (pr->same_screen > 0))
+            return root;
+
+        xcb_screen_next(&it);
+    }
+
+    return 0;
+}
 
-    return QPixmap::fromImage(image);
+QPixmap ZXCBTools::convertFromNative(xcb_image_t *xcbImage)
+{
+    return QPixmap::fromImage(imageFromNative(xcbImage->data, xcbImage->width, xcbImage->height,
+                                              static_cast<int>(xcbImage->stride), xcbImage->depth));
 }
 
 bool ZXCBTools::getWindowGeometry(xcb_window_t window, int &x, int &y, int &w, int &h)
@@ -141,6 +242,26 @@ bool ZXCBTools::getWindowGeometry(xcb_window_t window, int &x, int &y, int &w, i
     return false;
 }
 
+QRect ZXCBTools::getWindowRootGeometry(xcb_window_t window)
+{
+    xcb_connection_t *xcbConn = connection();
+
+    // both requests are sent before waiting for replies
+    xcb_get_geometry_cookie_t geomCookie = xcb_get_geometry_unchecked(xcbConn, window);
+    xcb_translate_coordinates_cookie_t translateCookie = xcb_translate_coordinates_unchecked(
+        xcbConn, window, appRootWindow(), 0, 0);
+
+    QScopedPointer<xcb_get_geometry_reply_t,QScopedPointerPodDeleter>
+            geomReply(xcb_get_geometry_reply(xcbConn, geomCookie, nullptr));
+    QScopedPointer<xcb_translate_coordinates_reply_t,QScopedPointerPodDeleter>
+            translateReply(xcb_translate_coordinates_reply(xcbConn, translateCookie, nullptr));
+
+    if (geomReply.isNull() || translateReply.isNull())
+        return QRect();
+
+    return QRect(translateReply->dst_x, translateReply->dst_y, geomReply->width, geomReply->height);
+}
+
 QPixmap ZXCBTools::getWindowPixmap(xcb_window_t window, bool blendPointer)
 {
     xcb_connection_t *xcbConn = connection();
@@ -155,29 +276,39 @@ QPixmap ZXCBTools::getWindowPixmap(xcb_window_t window, bool blendPointer)
 
     if (geomReply.isNull()) return QPixmap();
 
-    QScopedPointer<xcb_image_t,QScopedPointerPodDeleter>
-            xcbImage(xcb_image_get(xcbConn,
-                                   window,
-                                   geomReply->x,
-                                   geomReply->y,
-                                   geomReply->width,
-                                   geomReply->height,
-                                   ~0U,
-                                   XCB_IMAGE_FORMAT_Z_PIXMAP
-                                   ));
-
+    // shared memory capture avoids copying whole framebuffer through X socket
+    QPixmap nativePixmap = QPixmap::fromImage(getShmImage(window,
+                                                          geomReply->x,
+                                                          geomReply->y,
+                                                          geomReply->width,
+                                                          geomReply->height));
+
+    if (nativePixmap.isNull()) {
+        QScopedPointer<xcb_image_t,QScopedPointerPodDeleter>
+                xcbImage(xcb_image_get(xcbConn,
+                                       window,
+                                       geomReply->x,
+                                       geomReply->y,
+                                       geomReply->width,
+                                       geomReply->height,
+                                       ~0U,
+                                       XCB_IMAGE_FORMAT_Z_PIXMAP
+                                       ));
+
+
+        // if the image is null, this means we need to get the root image window
+        // and run a crop
+
+        if (!xcbImage) {
+            QRect geom(geomReply->x, geomReply->y, geomReply->width, geomReply->height);
+            return getWindowPixmap(appRootWindow(), blendPointer).copy(geom);
+        }
 
-    // if the image is null, this means we need to get the root image window
-    // and run a crop
+        // now process the image
 
-    if (!xcbImage) {
-        QRect geom(geomReply->x, geomReply->y, geomReply->width, geomReply->height);
-        return getWindowPixmap(appRootWindow(), blendPointer).copy(geom);
+        nativePixmap = convertFromNative(xcbImage.data());
     }
 
-    // now process the image
-
-    QPixmap nativePixmap = convertFromNative(xcbImage.data());
     if (!(blendPointer))
         return nativePixmap;
 
@@ -196,6 +327,45 @@ QPixmap ZXCBTools::getWindowPixmap(xcb_window_t window, bool blendPointer)
                             geomReply->width, geomReply->height);
 }
 
+QPixmap ZXCBTools::getScreenAreaPixmap(const QRect &area, bool blendPointer)
+{
+    // fetch only requested part of root window, without copying whole desktop
+    xcb_connection_t *xcbConn = connection();
+    const xcb_window_t root = appRootWindow();
+
+    xcb_get_geometry_cookie_t geomCookie = xcb_get_geometry_unchecked(xcbConn, root);
+    QScopedPointer<xcb_get_geometry_reply_t,QScopedPointerPodDeleter>
+            geomReply(xcb_get_geometry_reply(xcbConn, geomCookie, nullptr));
+
+    if (geomReply.isNull()) return QPixmap();
+
+    const QRect rect = area.intersected(QRect(0, 0, geomReply->width, geomReply->height));
+    if (rect.isEmpty()) return QPixmap();
+
+    QPixmap nativePixmap = QPixmap::fromImage(getShmImage(root, rect.x(), rect.y(), rect.width(), rect.height()));
+
+    if (nativePixmap.isNull()) {
+        QScopedPointer<xcb_image_t,QScopedPointerPodDeleter>
+                xcbImage(xcb_image_get(xcbConn,
+                                       root,
+                                       static_cast<int16_t>(rect.x()),
+                                       static_cast<int16_t>(rect.y()),
+                                       static_cast<uint16_t>(rect.width()),
+                                       static_cast<uint16_t>(rect.height()),
+                                       ~0U,
+                                       XCB_IMAGE_FORMAT_Z_PIXMAP
+                                       ));
+        if (!xcbImage) return QPixmap();
+
+        nativePixmap = convertFromNative(xcbImage.data());
+    }
+
+    if (!(blendPointer))
+        return nativePixmap;
+
+    return blendCursorImage(nativePixmap, rect.x(), rect.y(), rect.width(), rect.height());
+}
+
 QPixmap ZXCBTools::blendCursorImage(const QPixmap &pixmap, int x, int y, int width, int height)
 {
     // first we get the cursor position, compute the co-ordinates of the region
@@ -249,92 +419,228 @@ QPixmap ZXCBTools::blendCursorImage(const QPixmap &pixmap, int x, int y, int wid
     return blendedPixmap;
 }
 
-// Recursively iterates over the window w and its children, thereby building
-// a tree of window descriptors. Windows in non-viewable state or with height
-// or width smaller than minSize will be ignored.
-void ZXCBTools::getWindowsRecursive( QVector<QRect> &windows, xcb_window_t w, int rx, int ry, int depth )
+xcb_atom_t ZXCBTools::internAtom(const QByteArray &name)
 {
+    static QHash<QByteArray,xcb_atom_t> atoms;
+    static QMutex atomsMutex;
+
+    QMutexLocker locker(&atomsMutex);
+    auto it = atoms.constFind(name);
+    if (it != atoms.constEnd())
+        return it.value();
+
     xcb_connection_t* c = connection();
+    xcb_intern_atom_cookie_t ac = xcb_intern_atom(c, 0, static_cast<uint16_t>(name.size()), name.constData());
+    QScopedPointer<xcb_intern_atom_reply_t,QScopedPointerPodDeleter>
+            reply(xcb_intern_atom_reply(c, ac, nullptr));
 
-    xcb_get_window_attributes_cookie_t ac = xcb_get_window_attributes_unchecked(c, w);
-    QScopedPointer<xcb_get_window_attributes_reply_t,QScopedPointerPodDeleter>
-            atts(xcb_get_window_attributes_reply(c, ac, nullptr));
+    if (reply.isNull()) {
+        qWarning() << "Unable to allocate xcb atom" << name;
+        return XCB_NONE;
+    }
 
-    xcb_get_geometry_cookie_t gc = xcb_get_geometry_unchecked(c, w);
-    QScopedPointer<xcb_get_geometry_reply_t,QScopedPointerPodDeleter>
-            geom(xcb_get_geometry_reply(c, gc, nullptr));
-
-    if ( atts && geom &&
-            atts->map_state == XCB_MAP_STATE_VIEWABLE &&
-            geom->width >= minSize && geom->height >= minSize ) {
-        int x = 0;
-        int y = 0;
-        if ( depth != 0 ) {
-            x = geom->x + rx;
-            y = geom->y + ry;
-        }
+    atoms.insert(name, reply->atom);
+    return reply->atom;
+}
 
-        QRect r( x, y, geom->width, geom->height );
-        if (!windows.contains(r))
-            windows.append(r);
+// Iterates over the window tree level by level, thereby building a list
+// of window descriptors. All requests for one tree level are sent before
+// collecting replies, so each level costs a single round trip.
+// Windows in non-viewable state or with height or width smaller than
+// minSize will be ignored, as well as their children.
+QVector<ZWindowSnapshot::Window> ZXCBTools::getWindows( xcb_window_t root )
+{
+    class Pending {
+    public:
+        xcb_window_t window { XCB_NONE };
+        QPoint origin;
+        int depth { 0 };
+        xcb_get_window_attributes_cookie_t attributes {};
+        xcb_get_geometry_cookie_t geometry {};
+        xcb_query_tree_cookie_t tree {};
+    };
 
-        xcb_query_tree_cookie_t tc = xcb_query_tree_unchecked(c, w);
-        QScopedPointer<xcb_query_tree_reply_t,QScopedPointerPodDeleter>
-                tree(xcb_query_tree_reply(c, tc, nullptr));
+    xcb_connection_t* c = connection();
+    QVector<ZWindowSnapshot::Window> windows;
+
+    QVector<Pending> level;
+    Pending rootWindow;
+    rootWindow.window = root;
+    level.append(rootWindow);
+
+    while (!level.isEmpty()) {
+        for (auto &p : level) {
+            p.attributes = xcb_get_window_attributes_unchecked(c, p.window);
+            p.geometry = xcb_get_geometry_unchecked(c, p.window);
+            // children are requested speculatively, trees of skipped windows are discarded
+            p.tree = xcb_query_tree_unchecked(c, p.window);
+        }
 
-        if (tree) {
-            xcb_window_t* child = xcb_query_tree_children(tree.data());
-            for (unsigned int i=0;i<tree->children_len;i++)
-                getWindowsRecursive(windows, child[i], x, y, depth +1); // NOLINT
+        QVector<Pending> visible;
+        visible.reserve(level.count());
+        for (auto &p : level) {
+            QScopedPointer<xcb_get_window_attributes_reply_t,QScopedPointerPodDeleter>
+                    atts(xcb_get_window_attributes_reply(c, p.attributes, nullptr));
+            QScopedPointer<xcb_get_geometry_reply_t,QScopedPointerPodDeleter>
+                    geom(xcb_get_geometry_reply(c, p.geometry, nullptr));
+
+            if ( atts && geom &&
+                    atts->map_state == XCB_MAP_STATE_VIEWABLE &&
+                    geom->width >= minSize && geom->height >= minSize ) {
+                QPoint pos;
+                if ( p.depth != 0 )
+                    pos = p.origin + QPoint(geom->x, geom->y);
+
+                ZWindowSnapshot::Window w;
+                w.window = p.window;
+                w.rect = QRect( pos, QSize(geom->width, geom->height) );
+                w.depth = p.depth;
+                windows.append(w);
+
+                p.origin = pos;
+                visible.append(p);
+            } else {
+                xcb_discard_reply(c, p.tree.sequence);
+            }
         }
-    }
 
-    if ( depth == 0 ) {
-        std::sort(windows.begin(), windows.end(), []( const QRect& r1, const QRect& r2 )
-        {
-            return r1.width() * r1.height() < r2.width() * r2.height();
-        });
+        QVector<Pending> next;
+        for (const auto &p : std::as_const(visible)) {
+            QScopedPointer<xcb_query_tree_reply_t,QScopedPointerPodDeleter>
+                    tree(xcb_query_tree_reply(c, p.tree, nullptr));
+            if (tree.isNull())
+                continue;
+
+            const xcb_window_t* child = xcb_query_tree_children(tree.data());
+            for (int i=0; i<tree->children_len; i++) {
+                Pending np;
+                np.window = child[i]; // NOLINT
+                np.origin = p.origin;
+                np.depth = p.depth + 1;
+                next.append(np);
+            }
+        }
+        level = next;
     }
+
+    return windows;
 }
 
 xcb_window_t ZXCBTools::findRealWindow( xcb_window_t w, int depth )
 {
-    const char *wm_state_s = "WM_STATE";
+    const int maxDepth = 5;
 
     xcb_connection_t* c = connection();
 
-    if( depth > 5 )
+    const xcb_atom_t wmState = internAtom(QByteArrayLiteral("WM_STATE"));
+    if (wmState == XCB_NONE)
         return 0;
 
-    xcb_intern_atom_cookie_t ac = xcb_intern_atom(c, 0, strlen(wm_state_s), wm_state_s);
-    QScopedPointer<xcb_intern_atom_reply_t,QScopedPointerPodDeleter>
-            wm_state(xcb_intern_atom_reply(c, ac, nullptr));
+    // breadth-first search, one round trip per tree level, shallowest client window wins
+    QVector<xcb_window_t> level { w };
+    for (int d = depth; d <= maxDepth && !level.isEmpty(); d++) {
+        QVector<xcb_get_property_cookie_t> props;
+        QVector<xcb_query_tree_cookie_t> trees;
+        props.reserve(level.count());
+        trees.reserve(level.count());
+        for (const auto &win : std::as_const(level)) {
+            props.append(xcb_get_property(c, 0, win, wmState, XCB_GET_PROPERTY_TYPE_ANY, 0, 0));
+            trees.append(xcb_query_tree_unchecked(c, win));
+        }
 
-    if (wm_state.isNull()) {
-        qWarning() << "Unable to allocate xcb atom";
-        return 0;
+        xcb_window_t found = XCB_NONE;
+        for (int i=0; i<level.count(); i++) {
+            QScopedPointer<xcb_get_property_reply_t,QScopedPointerPodDeleter>
+                    pr(xcb_get_property_reply(c, props.at(i), nullptr));
+            if (found == XCB_NONE && pr && pr->type != XCB_NONE)
+                found = level.at(i);
+        }
+
+        QVector<xcb_window_t> next;
+        for (int i=0; i<level.count(); i++) {
+            // replies must be collected anyway, otherwise they pile up in the connection
+            QScopedPointer<xcb_query_tree_reply_t,QScopedPointerPodDeleter>
+                    tree(xcb_query_tree_reply(c, trees.at(i), nullptr));
+            if (found != XCB_NONE || tree.isNull())
+                continue;
+
+            const xcb_window_t* child = xcb_query_tree_children(tree.data());
+            for (int j=0; j<tree->children_len; j++)
+                next.append(child[j]); // NOLINT
+        }
+
+        if (found != XCB_NONE)
+            return found;
+
+        level = next;
     }
 
-    xcb_get_property_cookie_t pc = xcb_get_property(c, 0, w, wm_state->atom, XCB_GET_PROPERTY_TYPE_ANY, 0, 0 );
-    QScopedPointer<xcb_get_property_reply_t,QScopedPointerPodDeleter>
-            pr(xcb_get_property_reply(c, pc, nullptr));
+    return XCB_NONE;
+}
+
+ZWindowSnapshot ZXCBTools::windowSnapshot()
+{
+    return ZWindowSnapshot(getWindows(appRootWindow()));
+}
 
-    if (pr && pr->type != XCB_NONE)
-        return w;
+ZWindowSnapshot::ZWindowSnapshot(const QVector<Window> &windows)
+    : m_windows(windows)
+{
+    // uniform grid over desktop, each cell lists windows overlapping it
+    for (int i=0; i<m_windows.count(); i++) {
+        const QRect &r = m_windows.at(i).rect;
+        const int x1 = cellIndex(r.left());
+        const int x2 = cellIndex(r.right());
+        const int y1 = cellIndex(r.top());
+        const int y2 = cellIndex(r.bottom());
+        for (int cy = y1; cy <= y2; cy++) {
+            for (int cx = x1; cx <= x2; cx++)
+                m_grid[cellKey(cx,cy)].append(i);
+        }
+    }
+}
 
-    xcb_window_t ret = XCB_NONE;
+bool ZWindowSnapshot::isEmpty() const
+{
+    return m_windows.isEmpty();
+}
 
-    xcb_query_tree_cookie_t tc = xcb_query_tree_unchecked(c, w);
-    QScopedPointer<xcb_query_tree_reply_t,QScopedPointerPodDeleter>
-            tree(xcb_query_tree_reply(c, tc, nullptr));
+const QVector<ZWindowSnapshot::Window> &ZWindowSnapshot::windows() const
+{
+    return m_windows;
+}
 
-    if (tree) {
-        xcb_window_t* child = xcb_query_tree_children(tree.data());
-        for (unsigned int i=0;i<tree->children_len;i++)
-            ret = findRealWindow(child[i], depth +1 ); // NOLINT
+QRect ZWindowSnapshot::windowAt(const QPoint &pos) const
+{
+    // smallest window under pointer is the most specific one (widget, panel, client area)
+    const auto cell = m_grid.constFind(cellKey(cellIndex(pos.x()),cellIndex(pos.y())));
+    if (cell == m_grid.constEnd())
+        return QRect();
+
+    QRect res;
+    qint64 resArea = 0;
+    for (const int idx : cell.value()) {
+        const QRect &r = m_windows.at(idx).rect;
+        if (!r.contains(pos))
+            continue;
+        const qint64 area = static_cast<qint64>(r.width()) * r.height();
+        if (res.isNull() || area < resArea) {
+            res = r;
+            resArea = area;
+        }
     }
+    return res;
+}
 
-    return ret;
+int ZWindowSnapshot::cellIndex(int coord)
+{
+    // floor division, windows can be partially off-screen
+    return (coord >= 0) ? (coord / cellSize) : ((coord - cellSize + 1) / cellSize);
+}
+
+quint64 ZWindowSnapshot::cellKey(int cx, int cy)
+{
+    return (static_cast<quint64>(static_cast<quint32>(cx)) << 32U) | static_cast<quint32>(cy);
 }
 
 xcb_window_t ZXCBTools::windowUnderCursor( bool includeDecorations )
@@ -7,10 +7,43 @@
 #include <QPixmap>
 #include <QVector>
 #include <QRect>
+#include <QImage>
+#include <QMutex>
+#include <QHash>
+#include <QPoint>
+#include <QByteArray>
 
 #include <xcb/xcb.h>
 #include <xcb/xcb_image.h>
 #include <xcb/xfixes.h>
+#include <xcb/shm.h>
+
+class ZWindowSnapshot
+{
+public:
+    class Window {
+    public:
+        xcb_window_t window { XCB_NONE };
+        QRect rect; // root window coordinates
+        int depth { 0 };
+    };
+
+    ZWindowSnapshot() = default;
+    explicit ZWindowSnapshot(const QVector<Window> &windows);
+
+    bool isEmpty() const;
+    const QVector<Window> &windows() const;
+    QRect windowAt(const QPoint &pos) const;
+
+private:
+    static const int cellSize = 128;
+
+    QVector<Window> m_windows;
+    QHash<quint64,QVector<int> > m_grid;
+
+    static int cellIndex(int coord);
+    static quint64 cellKey(int cx, int cy);
+};
 
 class ZXCBTools : public QObject
 {
@@ -18,7 +51,18 @@ class ZXCBTools : public QObject
 
 private:
     xcb_connection_t* m_connection;
+    QMutex m_shmMutex;
+    xcb_shm_seg_t m_shmSeg { XCB_NONE };
+    uchar* m_shmAddr { nullptr };
+    size_t m_shmSize { 0 };
+    bool m_shmAvailable { false };
+
+    static ZXCBTools* instance();
     static xcb_connection_t* connection();
+    bool allocateShmSegment(size_t size);
+    void releaseShmSegment();
+    static QImage getShmImage(xcb_window_t window, int x, int y, int width, int height);
+    static QImage imageFromNative(const uchar *data, int width, int height, int bytesPerLine, int depth);
 
 public:
     explicit ZXCBTools(QObject *parent = nullptr);
@@ -27,9 +71,13 @@ public:
     static xcb_window_t appRootWindow();
     static QPixmap convertFromNative(xcb_image_t *xcbImage);
     static bool getWindowGeometry(xcb_window_t window, int &x, int &y, int &w, int &h);
+    static QRect getWindowRootGeometry(xcb_window_t window);
     static QPixmap getWindowPixmap(xcb_window_t window, bool blendPointer);
+    static QPixmap getScreenAreaPixmap(const QRect &area, bool blendPointer);
     static QPixmap blendCursorImage(const QPixmap &pixmap, int x, int y, int width, int height);
-    static void getWindowsRecursive( QVector<QRect> &windows, xcb_window_t w, int rx = 0, int ry = 0, int depth = 0 );
+    static xcb_atom_t internAtom(const QByteArray &name);
+    static QVector<ZWindowSnapshot::Window> getWindows( xcb_window_t root );
+    static ZWindowSnapshot windowSnapshot();
     static xcb_window_t findRealWindow( xcb_window_t w, int depth = 0 );
     static xcb_window_t windowUnderCursor( bool includeDecorations = true );
 };